@@ -35,6 +35,7 @@ public InventoryPlugin(ReadOnlyTargetRules Target) : base(Target)
 			"PhysX",
 			"HeadMountedDisplay",
 			"UMG",
+			"GameplayTags",
         });
 
 
@@ -47,8 +48,7 @@ public InventoryPlugin(ReadOnlyTargetRules Target) : base(Target)
                 "ShaderCore",
                 "NetworkReplayStreaming",
                 "AIModule",
-                "UMG",
-                "GameplayTags"
+                "UMG"
             });
 
 
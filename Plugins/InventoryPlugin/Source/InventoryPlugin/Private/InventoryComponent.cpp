@@ -1,6 +1,13 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "InventoryComponent.h"
+#include "InventoryPickupPlanner.h"
+#include "InventoryJournal.h"
+#include "InventoryRecorder.h"
+#include "InventoryStackId.h"
+#include "InventoryUseManager.h"
+#include "InventoryWorldItemRegistry.h"
+#include "UnrealNetwork.h"
 
 
 
@@ -11,7 +18,21 @@ UInventoryComponent::UInventoryComponent()
 	// off to improve performance if you don't need them.
 	PrimaryComponentTick.bCanEverTick = true;
 
-	// ...
+	// Replicate the inventory to the owning client
+	bReplicates = true;
+}
+
+// Replicate the authoritative inventory only to the owner
+void UInventoryComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME_CONDITION(UInventoryComponent, ServerItemArray, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(UInventoryComponent, LastProcessedSequence, COND_OwnerOnly);
+
+	// Simulated proxies only need to know what to draw
+	DOREPLIFETIME(UInventoryComponent, EquippedVisuals);
+	DOREPLIFETIME(UInventoryComponent, FallbackVisualClasses);
 }
 
 
@@ -20,8 +41,101 @@ void UInventoryComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// ...
-	
+	// Class totals are kept from here on, so counting never walks the stacks
+	EnsureAggregates();
+
+	InitEquipmentSlots();
+
+	if (bUseGrid)
+	{
+		RebuildGrid();
+	}
+
+	// Restore what the last session left behind and continue journaling from there
+	if (bEnableJournal && GetOwner()->HasAuthority())
+	{
+		if (JournalName.IsEmpty())
+		{
+			JournalName = GetOwner()->GetName();
+		}
+
+		RecoverFromJournal();
+		JournalHandle = FInventoryJournalWriter::Get().OpenJournal(JournalName);
+		CompactJournal();
+	}
+
+	if (bRecordOperations)
+	{
+		StartRecording(RecordingName.IsEmpty() ? GetOwner()->GetName() : RecordingName);
+	}
+}
+
+// Called when the game ends or the component is destroyed
+void UInventoryComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (JournalHandle != INDEX_NONE)
+	{
+		FInventoryJournalWriter::Get().CloseJournal(JournalHandle);
+		JournalHandle = INDEX_NONE;
+	}
+
+	StopRecording();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void UInventoryComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	// Readers on other threads see all changes of this frame at once, unchanged inventories keep their snapshot
+	if (bPublishSnapshots && bSnapshotDirty)
+	{
+		SnapshotPublisher->Publish(FInventorySnapshotPtr(new FInventorySnapshot(++SnapshotVersion, ItemArray)));
+		bSnapshotDirty = false;
+	}
+	else
+	{
+		SnapshotPublisher->ReclaimRetired();
+	}
+
+	AActor* Owner = GetOwner();
+	if (!Owner)
+		return;
+
+	if (Owner->HasAuthority())
+	{
+		// Publish all changes of this frame to the owning client at once
+		if (bInventoryDirty && (GetNetMode() != NM_Standalone))
+		{
+			ServerItemArray = ItemArray;
+		}
+		bInventoryDirty = false;
+
+		// Compacting between frames never catches a change half way, like a removal journaled before the stack left ItemArray
+		if ((JournalHandle != INDEX_NONE) && (JournalRecordsSinceCompaction >= JournalCompactionInterval))
+		{
+			CompactJournal();
+		}
+
+		return;
+	}
+
+	// Send queued commands once per net update
+	TimeSinceCommandFlush += DeltaTime;
+	if ((OutgoingCommands.Num() == 0) || (TimeSinceCommandFlush < 1.f / FMath::Max(Owner->NetUpdateFrequency, 1.f)))
+		return;
+
+	TimeSinceCommandFlush = 0.f;
+
+	for (int32 First = 0; First < OutgoingCommands.Num(); First += MaxCommandsPerBatch)
+	{
+		const int32 Count = FMath::Min(MaxCommandsPerBatch, OutgoingCommands.Num() - First);
+		ServerExecuteCommands(TArray<FInventoryCommand>(OutgoingCommands.GetData() + First, Count));
+	}
+
+	OutgoingCommands.Reset();
 }
 
 // Add an item from the scene to the inventory
@@ -30,176 +144,475 @@ bool UInventoryComponent::AddItem(AItem* InItem)
 	if(!InItem->IsValidLowLevel())
 		return false;
 
-	ACharacter* Character = Cast<ACharacter>(GetOwner());
-	FActorSpawnParameters SpawnInfo;
-	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-
-	// Check type of item and call respective function
-	switch (InItem->Type)
+	if (InItem->Type == EItemType::DEFAULT)
 	{
-		case EItemType::DEFAULT : AddDefaultItem(InItem);
-			break;
-		case EItemType::BACKPACK : AddBackpackItem(InItem);
-			break;
-		case EItemType::WEAPON : AddWeaponItem(InItem);
-			break;
-		case EItemType::COSMETIC : AddCosmeticItem(InItem);
-			break;
+		AddDefaultItem(InItem);
+		return true;
 	}
 
+	// Everything else goes into the first equipment slot for its type
+	const int32 SlotIndex = GetEquipmentTable()->FindSlotForType(InItem->Type);
+	if (SlotIndex == INDEX_NONE)
+		return false;
+
+	EquipItem(InItem, SlotIndex);
+
 	return true;
 }
 
 void UInventoryComponent::AddDefaultItem(AItem* InItem)
+{
+	int32 PickupAmount = CalculatePickupAmount(InItem, InItem->PickupAmount);
+
+	if (PickupAmount > 0)
+	{
+		PickupDefaultItem(InItem, PickupAmount);
+	}
+}
+
+// Amount of an offered stack that fits into the remaining weight capacity
+int32 UInventoryComponent::CalculatePickupAmount(AItem* ItemData, int32 OfferedAmount)
 {
 	int32 PickupAmount = 1;
-	int32 StackWeight = 1;
-	bool bPickWholeStack = false;
 
 	// Check if inventory has enough space for this item
-	if ((CalculateInventoryWeight() + (InItem->ItemWeight * InItem->PickupAmount)) > MaxIntentoryWeight)
+	if ((ItemData->ItemWeight > 0) && ((CalculateInventoryWeight() + (ItemData->ItemWeight * OfferedAmount)) > MaxIntentoryWeight))
 	{
 		// Not enough space for whole stack
 		if (CalculateInventoryWeight() >= MaxIntentoryWeight)
 		{
 			// Inventory is completely full, broadcast Out of Space Delegate
 			OnOutOfSpace.Broadcast();
-			return;
+			return 0;
 		}
 		else
 		{
 			// Pickup as much as we can of the item stack
-			PickupAmount = FMath::DivideAndRoundDown((MaxIntentoryWeight - CalculateInventoryWeight()), InItem->ItemWeight);
+			PickupAmount = FMath::DivideAndRoundDown((MaxIntentoryWeight - CalculateInventoryWeight()), ItemData->ItemWeight);
 			if (PickupAmount <= 0)
 			{
 				OnOutOfSpace.Broadcast();
-				return;
+				return 0;
 			}
-
-			InItem->PickupAmount -= PickupAmount;
 		}
 	}
 	else
 	{
 		// Pickup whole stack
-		PickupAmount = InItem->PickupAmount;
-		bPickWholeStack = true;
+		PickupAmount = OfferedAmount;
 	}
 
-	// Create inventory struct
-	FInventoryStruct NewItem(InItem->GetClass(), InItem->ItemName, InItem->ItemDescription, PickupAmount, InItem->ItemMaxAmount, 
-		InItem->ItemWeight, InItem->ItemThumbnail, InItem->WeightBonus, CalculateUniqueID(), InItem->SortPriority, InItem->Type);
+	return PickupAmount;
+}
 
-	// Try to combine with existing stacks
-	FInventoryStruct CombineStruct;
-	int32 CombineIndex;
-	if (FindStackByClass(InItem->GetClass(), false, CombineStruct, CombineIndex))
+// Move the given amount of a default item into the inventory and return the amount picked up
+int32 UInventoryComponent::PickupDefaultItem(AItem* InItem, int32 PickupAmount)
+{
+	int32 AddedAmount = AddDefaultStack(InItem, PickupAmount);
+
+	if (AddedAmount <= 0)
+		return 0;
+
+	// Destroy Item in scene
+	if (AddedAmount >= InItem->PickupAmount)
 	{
-		int32 newIndex = ItemArray.Add(NewItem);
-		CombineStack(CombineIndex, newIndex);
+		InItem->Destroy();
 	}
 	else
 	{
+		InItem->PickupAmount -= AddedAmount;
+	}
+
+	return AddedAmount;
+}
+
+// Add an item from its class defaults without an actor in the scene
+int32 UInventoryComponent::AddItemFromClass(TSubclassOf<class AItem> ItemClass, int32 Amount)
+{
+	if (!ItemClass || (Amount <= 0))
+		return 0;
+
+	AItem* DefaultItem = ItemClass->GetDefaultObject<AItem>();
+	if (DefaultItem->Type != EItemType::DEFAULT)
+		return 0;
+
+	int32 PickupAmount = CalculatePickupAmount(DefaultItem, Amount);
+
+	return (PickupAmount > 0) ? AddDefaultStack(DefaultItem, PickupAmount) : 0;
+}
+
+// Fill partial stacks of the item class, then add full stacks and one remainder, only reads the item data so class defaults work as well
+int32 UInventoryComponent::AddDefaultStack(AItem* InItem, int32 PickupAmount)
+{
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	if (IsRecordingOperation())
+	{
+		Recorder->Record(*this, FString::Printf(TEXT("ADD %s %d"), *InItem->GetClass()->GetPathName(), PickupAmount));
+	}
+
+	UClass* ItemClass = InItem->GetClass();
+	const int32 MaxAmount = InItem->ItemMaxAmount;
+	int32 RemainingAmount = PickupAmount;
+
+	// Top up every partial stack of this class in one pass, stacks without a max amount are never topped up
+	if (MaxAmount > 0)
+	{
+		for (int32 Index = 0; (Index < ItemArray.Num()) && (RemainingAmount > 0); Index++)
+		{
+			FInventoryStruct& Stack = ItemArray[Index];
+			if ((Stack.ItemClass != ItemClass) || (Stack.ItemAmount >= Stack.ItemMaxAmount))
+				continue;
+
+			int32 AddedAmount = FMath::Min(Stack.ItemMaxAmount - Stack.ItemAmount, RemainingAmount);
+			Stack.ItemAmount += AddedAmount;
+			RemainingAmount -= AddedAmount;
+
+			JournalStack(Index);
+		}
+	}
+
+	// Then only as many full stacks as needed plus one remainder stack
+	int32 NumNewStacks = (MaxAmount > 0) ? FMath::DivideAndRoundUp(RemainingAmount, MaxAmount) : ((RemainingAmount > 0) ? 1 : 0);
+	ReserveStacks(NumNewStacks);
+
+	while (RemainingAmount > 0)
+	{
+		int32 StackAmount = (MaxAmount > 0) ? FMath::Min(RemainingAmount, MaxAmount) : RemainingAmount;
+
+		// In grid mode every new stack needs free cells, whatever does not fit stays in the scene
+		int32 GridX = -1;
+		int32 GridY = -1;
+		if (bUseGrid && !FindGridPosition(InItem->ItemGridWidth, InItem->ItemGridHeight, GridX, GridY))
+		{
+			OnOutOfSpace.Broadcast();
+			break;
+		}
+
+		// Create inventory struct
+		FInventoryStruct NewItem(ItemClass, InItem->ItemName, InItem->ItemDescription, StackAmount, MaxAmount,
+			InItem->ItemWeight, InItem->ItemThumbnail, InItem->WeightBonus, CalculateUniqueID(), InItem->SortPriority, InItem->Type);
+		NewItem.GlobalID = GenerateGlobalID();
+		NewItem.GridWidth = InItem->ItemGridWidth;
+		NewItem.GridHeight = InItem->ItemGridHeight;
+
+		if (bUseGrid)
+		{
+			NewItem.GridX = GridX;
+			NewItem.GridY = GridY;
+			Grid.Occupy(GridX, GridY, NewItem.GridWidth, NewItem.GridHeight);
+		}
+
 		// Add to inventory array
-		int32 newIndex = ItemArray.Add(NewItem);
+		int32 NewIndex = ItemArray.Add(NewItem);
+		JournalStack(NewIndex);
+
+		RemainingAmount -= StackAmount;
 	}
 
-	// Destroy Item in scene
-	if (bPickWholeStack)
+	int32 AddedAmount = PickupAmount - RemainingAmount;
+	if (AddedAmount > 0)
 	{
-		InItem->Destroy();
+		MarkInventoryDirty();
 	}
-		
+
+	return AddedAmount;
 }
 
+// Choose how much of each candidate to pick up within the remaining capacity
+bool UInventoryComponent::PlanPickup(const TArray<AItem*>& Candidates, EPickupValueMethod ValueMethod, TArray<FPickupPlanEntry>& OutPlan)
+{
+	OutPlan.Reset();
+
+	TArray<FInventoryPickupCandidate> PlannerCandidates;
+	TArray<AItem*> PlannerItems;
+	PlannerCandidates.Reserve(Candidates.Num());
+	PlannerItems.Reserve(Candidates.Num());
 
-void UInventoryComponent::AddBackpackItem(AItem* InItem)
+	// Only default items take up inventory weight, equipment is handled by AddItem
+	for (AItem* Candidate : Candidates)
+	{
+		if (!Candidate->IsValidLowLevel() || (Candidate->Type != EItemType::DEFAULT) || (Candidate->PickupAmount <= 0))
+			continue;
+
+		PlannerCandidates.Add(FInventoryPickupCandidate(Candidate->ItemWeight, CalculatePickupValue(Candidate, ValueMethod), Candidate->PickupAmount));
+		PlannerItems.Add(Candidate);
+	}
+
+	TArray<int32> Amounts;
+	FInventoryPickupPlanner::Plan(PlannerCandidates, MaxIntentoryWeight - CalculateInventoryWeight(), Amounts);
+
+	for (int32 Index = 0; Index < Amounts.Num(); Index++)
+	{
+		if (Amounts[Index] > 0)
+		{
+			OutPlan.Add(FPickupPlanEntry(PlannerItems[Index], Amounts[Index]));
+		}
+	}
+
+	return OutPlan.Num() > 0;
+}
+
+// Pick up the amounts of a previously created plan
+bool UInventoryComponent::ApplyPickupPlan(const TArray<FPickupPlanEntry>& Plan)
 {
-	// Create inventory struct
-	FInventoryStruct NewItem(InItem->GetClass(), InItem->ItemName, InItem->ItemDescription, InItem->PickupAmount, 
-		InItem->ItemMaxAmount, InItem->ItemWeight, InItem->ItemThumbnail, InItem->WeightBonus, CalculateUniqueID(), InItem->SortPriority, InItem->Type);
+	bool bPickedUp = false;
 
-	// Drop current backpack (if existent)
-	if (BackpackMesh)
+	for (const FPickupPlanEntry& Entry : Plan)
 	{
-		// Destroy current backpack
-		BackpackMesh->DestroyComponent();
-		BackpackMesh->SetActive(false);
-		MaxIntentoryWeight -= EquippedBackpack.WeightBonus;
+		if (!Entry.Item->IsValidLowLevel() || (Entry.Amount <= 0))
+			continue;
+
+		// The scene or inventory may have changed since planning, never take more than what is left or fits
+		int32 PickupAmount = FMath::Min(Entry.Amount, Entry.Item->PickupAmount);
+		if (Entry.Item->ItemWeight > 0)
+		{
+			PickupAmount = FMath::Min(PickupAmount, FMath::DivideAndRoundDown((MaxIntentoryWeight - CalculateInventoryWeight()), Entry.Item->ItemWeight));
+		}
 
-		// Spawn backpack on ground
-		DropItem(EquippedBackpack);
+		if (PickupAmount <= 0)
+		{
+			OnOutOfSpace.Broadcast();
+			continue;
+		}
+
+		if (PickupDefaultItem(Entry.Item, PickupAmount) > 0)
+		{
+			bPickedUp = true;
+		}
 	}
 
-	// Set backpack slot
-	EquippedBackpack = NewItem;
-	MaxIntentoryWeight += EquippedBackpack.WeightBonus;
+	return bPickedUp;
+}
 
-	// Spawn and attach backpack mesh
-	ACharacter* Character = Cast<ACharacter>(GetOwner());
-	BackpackMesh = NewObject<UStaticMeshComponent>(Character->GetMesh(), NAME_None);
-	AttachItemMeshToCharacter(InItem->ItemMesh->GetStaticMesh(), TEXT("BackpackSocket"), BackpackMesh);
+// Value of a single unit of this item for the pickup planner
+int32 UInventoryComponent::CalculatePickupValue(AItem* InItem, EPickupValueMethod ValueMethod)
+{
+	switch (ValueMethod)
+	{
+	case EPickupValueMethod::AMOUNT :
+		return 1;
 
-	// Destroy Item in scene
-	InItem->Destroy();
+	case EPickupValueMethod::WEIGHT :
+		return FMath::Max(InItem->ItemWeight, 1);
+
+	default:
+		// Offset so items without priority still fill up spare capacity
+		return FMath::Max(InItem->SortPriority, 0) + 1;
+	}
 }
 
-void UInventoryComponent::AddWeaponItem(AItem* InItem)
+// Put an item into a slot, the previous item of the slot is dropped
+void UInventoryComponent::EquipItem(AItem* InItem, int32 SlotIndex)
 {
+	InitEquipmentSlots();
+
 	// Create inventory struct
 	FInventoryStruct NewItem(InItem->GetClass(), InItem->ItemName, InItem->ItemDescription, InItem->PickupAmount, 
 		InItem->ItemMaxAmount, InItem->ItemWeight, InItem->ItemThumbnail, InItem->WeightBonus, CalculateUniqueID(), InItem->SortPriority, InItem->Type);
 
-	// Drop current weapon (if existent)
-	if (WeaponMesh)
-	{
-		// Destroy current weapon
-		WeaponMesh->DestroyComponent();
-		WeaponMesh->SetActive(false);
-
-		// Spawn weapon on ground
-		DropItem(EquippedWeapon);
-	}
+	// Spawn the current item of the slot on the ground
+	UnequipSlot(SlotIndex);
 
-	// Set weapon slot
-	EquippedWeapon = NewItem;
+	EquippedItems[SlotIndex] = NewItem;
+	MaxIntentoryWeight += CalculateEquipmentCapacity(SlotIndex, NewItem);
 
-	// Spawn and attach weapon mesh
-	ACharacter* Character = Cast<ACharacter>(GetOwner());
-	WeaponMesh = NewObject<UStaticMeshComponent>(Character->GetMesh(), NAME_None);
-	AttachItemMeshToCharacter(InItem->ItemMesh->GetStaticMesh(), TEXT("WeaponSocket"), WeaponMesh);
+	SetEquippedVisual(SlotIndex, InItem->GetClass());
 
 	// Destroy Item in scene
 	InItem->Destroy();
 }
 
+// Drop the item of a slot into the scene
+bool UInventoryComponent::UnequipSlot(int32 SlotIndex)
+{
+	if (!EquippedItems.IsValidIndex(SlotIndex) || !EquippedItems[SlotIndex].ItemClass)
+		return false;
+
+	const FInventoryStruct Unequipped = EquippedItems[SlotIndex];
+	EquippedItems[SlotIndex] = FInventoryStruct();
+	MaxIntentoryWeight -= CalculateEquipmentCapacity(SlotIndex, Unequipped);
+
+	SetEquippedVisual(SlotIndex, nullptr);
+	DropItem(Unequipped);
+
+	return true;
+}
+
+// Equip into the slot named Backpack
+void UInventoryComponent::AddBackpackItem(AItem* InItem)
+{
+	const int32 SlotIndex = FindEquipmentSlot(TEXT("Backpack"));
+	if (SlotIndex != INDEX_NONE)
+	{
+		EquipItem(InItem, SlotIndex);
+	}
+}
+
+// Equip into the slot named Weapon
+void UInventoryComponent::AddWeaponItem(AItem* InItem)
+{
+	const int32 SlotIndex = FindEquipmentSlot(TEXT("Weapon"));
+	if (SlotIndex != INDEX_NONE)
+	{
+		EquipItem(InItem, SlotIndex);
+	}
+}
+
+// Equip into the slot named Cosmetic
 void UInventoryComponent::AddCosmeticItem(AItem* InItem)
 {
-	// Create inventory struct
-	FInventoryStruct NewItem(InItem->GetClass(), InItem->ItemName, InItem->ItemDescription, InItem->PickupAmount, 
-		InItem->ItemMaxAmount, InItem->ItemWeight, InItem->ItemThumbnail, InItem->WeightBonus, CalculateUniqueID(), InItem->SortPriority, InItem->Type);
+	const int32 SlotIndex = FindEquipmentSlot(TEXT("Cosmetic"));
+	if (SlotIndex != INDEX_NONE)
+	{
+		EquipItem(InItem, SlotIndex);
+	}
+}
 
-	// Drop current cosmetic (if existent)
-	if (CosmeticMesh)
+// Copy the slots named Backpack, Weapon and Cosmetic into the members of the old fixed slots
+void UInventoryComponent::SyncNamedEquipment()
+{
+	auto SyncSlot = [this](FName SlotName, FInventoryStruct& OutItem, UStaticMeshComponent*& OutMesh)
 	{
-		// Destroy current cosmetic
-		CosmeticMesh->DestroyComponent();
-		CosmeticMesh->SetActive(false);
+		const int32 SlotIndex = FindEquipmentSlot(SlotName);
+		OutItem = EquippedItems.IsValidIndex(SlotIndex) ? EquippedItems[SlotIndex] : FInventoryStruct();
+		OutMesh = EquippedMeshes.IsValidIndex(SlotIndex) ? EquippedMeshes[SlotIndex] : nullptr;
+	};
+
+	SyncSlot(TEXT("Backpack"), EquippedBackpack, BackpackMesh);
+	SyncSlot(TEXT("Weapon"), EquippedWeapon, WeaponMesh);
+	SyncSlot(TEXT("Cosmetic"), EquippedCosmetic, CosmeticMesh);
+}
+
+// Slot id of a slot name, INDEX_NONE if the table has no such slot
+int32 UInventoryComponent::FindEquipmentSlot(FName SlotName) const
+{
+	return GetEquipmentTable()->FindSlot(SlotName);
+}
+
+// Item in a slot, false if the slot is empty
+bool UInventoryComponent::GetEquippedItem(int32 SlotIndex, FInventoryStruct& OutItem) const
+{
+	if (!EquippedItems.IsValidIndex(SlotIndex) || !EquippedItems[SlotIndex].ItemClass)
+		return false;
+
+	OutItem = EquippedItems[SlotIndex];
+	return true;
+}
+
+// The equipment table in use
+const UInventoryEquipmentTable* UInventoryComponent::GetEquipmentTable() const
+{
+	return EquipmentTable ? EquipmentTable : GetDefault<UInventoryEquipmentTable>();
+}
+
+// Size the equipment arrays to the table
+void UInventoryComponent::InitEquipmentSlots()
+{
+	const int32 NumSlots = GetEquipmentTable()->Slots.Num();
+	if (EquippedItems.Num() == NumSlots)
+		return;
+
+	EquippedItems.SetNum(NumSlots);
+	EquippedVisuals.SetNumZeroed(NumSlots);
+	ResizeEquippedMeshes(NumSlots);
+}
+
+// Capacity an item adds while it is equipped in a slot
+int32 UInventoryComponent::CalculateEquipmentCapacity(int32 SlotIndex, const FInventoryStruct& Item) const
+{
+	const FInventoryEquipmentSlot& Slot = GetEquipmentTable()->Slots[SlotIndex];
+	return Slot.CapacityBonus + (Slot.bAppliesWeightBonus ? Item.WeightBonus : 0);
+}
 
-		// Spawn cosmetic on ground
-		DropItem(EquippedCosmetic);
+// Publish the item class of a slot to other clients and show it here
+void UInventoryComponent::SetEquippedVisual(int32 SlotIndex, UClass* ItemClass)
+{
+	// Two bytes per slot instead of an object reference
+	uint16 VisualId = 0;
+	if (ItemClass)
+	{
+		const int32 DefinitionId = ItemDatabase ? ItemDatabase->GetDefinitionId(ItemClass) : 0;
+		if ((DefinitionId > 0) && (DefinitionId < FallbackVisualBit))
+		{
+			VisualId = (uint16)DefinitionId;
+		}
+		else
+		{
+			// Without a definition the class itself is sent once and referenced by its index from then on
+			const int32 FallbackIndex = FallbackVisualClasses.AddUnique(ItemClass);
+			VisualId = (FallbackIndex < FallbackVisualBit) ? (FallbackVisualBit | (uint16)FallbackIndex) : 0;
+		}
 	}
+	EquippedVisuals[SlotIndex] = VisualId;
+
+	ShowEquippedVisual(SlotIndex, ItemClass);
+	SyncNamedEquipment();
+}
+
+// Attach the mesh of an item class to the socket of a slot on this machine, null clears the slot
+void UInventoryComponent::ShowEquippedVisual(int32 SlotIndex, UClass* ItemClass)
+{
+	const AItem* DefaultItem = ItemClass ? ItemClass->GetDefaultObject<AItem>() : nullptr;
+	UStaticMesh* StaticMesh = (DefaultItem && DefaultItem->ItemMesh) ? DefaultItem->ItemMesh->GetStaticMesh() : nullptr;
+
+	UStaticMeshComponent*& MeshSlot = EquippedMeshes[SlotIndex];
+	if (MeshSlot && (MeshSlot->GetStaticMesh() == StaticMesh))
+		return;
 
-	// Set cosmetic slot
-	EquippedCosmetic = NewItem;
+	if (MeshSlot)
+	{
+		MeshSlot->DestroyComponent();
+		MeshSlot = nullptr;
+	}
 
-	// Spawn and attach cosmetic mesh
 	ACharacter* Character = Cast<ACharacter>(GetOwner());
-	CosmeticMesh = NewObject<UStaticMeshComponent>(Character->GetMesh(), NAME_None);
-	AttachItemMeshToCharacter(InItem->ItemMesh->GetStaticMesh(), TEXT("CosmeticSocket"), CosmeticMesh);
+	if (!StaticMesh || !Character)
+		return;
 
-	// Destroy Item in scene
-	InItem->Destroy();
+	MeshSlot = NewObject<UStaticMeshComponent>(Character->GetMesh(), NAME_None);
+	AttachItemMeshToCharacter(StaticMesh, GetEquipmentTable()->Slots[SlotIndex].SocketName, MeshSlot);
+}
+
+// Item class of a visual id, null if empty or unknown
+UClass* UInventoryComponent::GetEquippedVisualClass(uint16 VisualId) const
+{
+	if (VisualId & FallbackVisualBit)
+	{
+		const int32 FallbackIndex = VisualId & ~FallbackVisualBit;
+		return FallbackVisualClasses.IsValidIndex(FallbackIndex) ? FallbackVisualClasses[FallbackIndex] : nullptr;
+	}
+
+	return (VisualId && ItemDatabase) ? ItemDatabase->GetDefinitionClass(VisualId) : nullptr;
+}
+
+// Size the attached meshes to a slot count, meshes of slots that are gone are destroyed
+void UInventoryComponent::ResizeEquippedMeshes(int32 NumSlots)
+{
+	for (int32 SlotIndex = NumSlots; SlotIndex < EquippedMeshes.Num(); SlotIndex++)
+	{
+		if (EquippedMeshes[SlotIndex])
+		{
+			EquippedMeshes[SlotIndex]->DestroyComponent();
+		}
+	}
+
+	EquippedMeshes.SetNumZeroed(NumSlots);
+}
+
+// Equipment of the server changed, update the attached meshes
+void UInventoryComponent::OnRep_EquippedVisuals()
+{
+	// The server may use a table with another size than the defaults of this machine
+	ResizeEquippedMeshes(EquippedVisuals.Num());
+
+	// A class may arrive after the id that references it, the next call shows it
+	const int32 NumSlots = FMath::Min(EquippedVisuals.Num(), GetEquipmentTable()->Slots.Num());
+	for (int32 SlotIndex = 0; SlotIndex < NumSlots; SlotIndex++)
+	{
+		ShowEquippedVisual(SlotIndex, GetEquippedVisualClass(EquippedVisuals[SlotIndex]));
+	}
+
+	SyncNamedEquipment();
 }
 
 // Attach the item mesh to socket
@@ -226,19 +639,36 @@ bool UInventoryComponent::DropItem(FInventoryStruct InInventoryStruct)
 	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
 	FVector DropLocation = Character->GetMesh()->GetSocketLocation(TEXT("ItemSpawnSocket"));
 
-	// Spawn Item in scene
-	AItem* DroppedItem = GetWorld()->SpawnActor<AItem>(InInventoryStruct.ItemClass, DropLocation, FRotator::ZeroRotator, SpawnInfo);
+	AInventoryWorldItemRegistry* WorldItems = bDropAsWorldItem ? AInventoryWorldItemRegistry::Get(GetWorld()) : nullptr;
+	if (WorldItems)
+	{
+		// Store as record, no actor until someone comes close
+		WorldItems->AddWorldItem(InInventoryStruct.ItemClass, InInventoryStruct.ItemAmount, FTransform(DropLocation));
+	}
+	else
+	{
+		// Spawn Item in scene
+		AItem* DroppedItem = GetWorld()->SpawnActor<AItem>(InInventoryStruct.ItemClass, DropLocation, FRotator::ZeroRotator, SpawnInfo);
 
-	// Adjust variables
-	DroppedItem->PickupAmount = InInventoryStruct.ItemAmount;
+		// Adjust variables
+		DroppedItem->PickupAmount = InInventoryStruct.ItemAmount;
+	}
 
 	// Remove from Inventory array
 	if (InInventoryStruct.ItemType == EItemType::DEFAULT)
 	{
+		TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+		if (IsRecordingOperation())
+		{
+			Recorder->Record(*this, FString::Printf(TEXT("DROP %d"), InInventoryStruct.UniqueID));
+		}
+
 		FInventoryStruct StackToRemove;
 		int32 IndexToRemove = 0;
-		FindItemStackByUniqueID(InInventoryStruct.UniqueID, StackToRemove, IndexToRemove);
-		ItemArray.RemoveAt(IndexToRemove);
+		if (FindItemStackByUniqueID(InInventoryStruct.UniqueID, StackToRemove, IndexToRemove))
+		{
+			RemoveStackAt(IndexToRemove);
+		}
 	}
 
 	return true;
@@ -247,6 +677,10 @@ bool UInventoryComponent::DropItem(FInventoryStruct InInventoryStruct)
 // Use item an item of this class
 bool UInventoryComponent::UseItem(TSubclassOf<class AItem> ItemClass)
 {
+	// Reject before searching the stack
+	if (IsItemOnCooldown(ItemClass))
+		return false;
+
 	FInventoryStruct InInventoryStruct;
 	int32 InIndex;
 
@@ -254,25 +688,95 @@ bool UInventoryComponent::UseItem(TSubclassOf<class AItem> ItemClass)
 	if (!(FindStackByClass(ItemClass, true, InInventoryStruct, InIndex)))
 		return false;
 
-	// Remove 1 from stack
-	RemoveFromStack(InIndex, 1, false);
+	return UseStackAt(InIndex);
+}
 
-	// Spawn temp item to access use function
-	FActorSpawnParameters SpawnInfo;
-	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-	AItem* TempItem = GetWorld()->SpawnActor<AItem>(InInventoryStruct.ItemClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnInfo);
+// Remove one item from a stack and queue its use event
+bool UInventoryComponent::UseStackAt(int32 StackIndex)
+{
+	TSubclassOf<class AItem> ItemClass = ItemArray[StackIndex].ItemClass;
+
+	// Rejected uses don't touch the stack or spawn anything
+	if (!TryStartUseCooldown(ItemClass))
+		return false;
+
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	if (IsRecordingOperation())
+	{
+		Recorder->Record(*this, FString::Printf(TEXT("REMOVE %d 1 0"), StackIndex));
+	}
+
+	// Remove 1 from stack
+	RemoveFromStack(StackIndex, 1, false);
+
+	// The use event runs with the batch of this frame
+	if (AInventoryUseManager* UseManager = AInventoryUseManager::Get(GetWorld()))
+	{
+		UseManager->EnqueueUse(this, ItemClass);
+	}
+
+	return true;
+}
+
+// Check if items of this class can't be used right now
+bool UInventoryComponent::IsItemOnCooldown(TSubclassOf<class AItem> ItemClass) const
+{
+	return GetRemainingCooldown(ItemClass) > 0.f;
+}
+
+// Seconds until items of this class can be used again
+float UInventoryComponent::GetRemainingCooldown(TSubclassOf<class AItem> ItemClass) const
+{
+	const float* EndTime = UseCooldownEndTimes.Find(ItemClass);
+	if (!EndTime || !GetWorld())
+		return 0.f;
+
+	return FMath::Max(*EndTime - GetWorld()->GetTimeSeconds(), 0.f);
+}
+
+// Start the cooldown of a class, false if it is still running
+bool UInventoryComponent::TryStartUseCooldown(TSubclassOf<class AItem> ItemClass)
+{
+	if (IsItemOnCooldown(ItemClass))
+		return false;
 
-	TempItem->OnUse();
+	const float Cooldown = ItemClass->GetDefaultObject<AItem>()->UseCooldown;
+	AInventoryUseManager* UseManager = AInventoryUseManager::Get(GetWorld());
 
-	// Destroy after use
-	TempItem->Destroy();
+	// Without world there is no time to measure the cooldown against
+	if (Cooldown > 0.f && UseManager)
+	{
+		UseCooldownEndTimes.Add(ItemClass, GetWorld()->GetTimeSeconds() + Cooldown);
+		UseManager->StartCooldown(this, ItemClass, Cooldown);
+	}
 
 	return true;
 }
 
+// Called by the use manager when a cooldown ran out
+void UInventoryComponent::FinishUseCooldown(TSubclassOf<class AItem> ItemClass)
+{
+	if (UseCooldownEndTimes.Remove(ItemClass) > 0)
+	{
+		OnUseCooldownFinished.Broadcast(ItemClass);
+	}
+}
+
 // Split selected item stack into two seperate stacks
 bool UInventoryComponent::SplitStack(int32 InIndex, int32 SplitAmount)
 {
+	return SplitStackWithID(InIndex, SplitAmount, CalculateUniqueID());
+}
+
+// Split a stack giving the new stack the given ID
+bool UInventoryComponent::SplitStackWithID(int32 InIndex, int32 SplitAmount, int32 NewUniqueID)
+{
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	if (IsRecordingOperation())
+	{
+		Recorder->Record(*this, FString::Printf(TEXT("SPLIT %d %d %d"), InIndex, SplitAmount, NewUniqueID));
+	}
+
 	FInventoryStruct InventoryStruct;
 	int32 Remainder;
 
@@ -284,15 +788,35 @@ bool UInventoryComponent::SplitStack(int32 InIndex, int32 SplitAmount)
 		return false;
 	}
 
+	// The split stack needs free cells in grid mode
+	int32 GridX, GridY;
+	if (bUseGrid && !FindGridPosition(InventoryStruct.GridWidth, InventoryStruct.GridHeight, GridX, GridY))
+	{
+		return false;
+	}
+
 	// Calculate new amounts
 	Remainder = InventoryStruct.ItemAmount - SplitAmount;
 	ItemArray[InIndex].ItemAmount = InventoryStruct.ItemAmount - SplitAmount;
 
 	// Add the split stack to inventory
 	FInventoryStruct NewStack(InventoryStruct.ItemClass, InventoryStruct.ItemName, InventoryStruct.ItemDescription, SplitAmount, InventoryStruct.ItemMaxAmount, InventoryStruct.ItemWeight, 
-		InventoryStruct.ItemThumbnail, InventoryStruct.WeightBonus, CalculateUniqueID(), InventoryStruct.SortPriority, InventoryStruct.ItemType);
+		InventoryStruct.ItemThumbnail, InventoryStruct.WeightBonus, NewUniqueID, InventoryStruct.SortPriority, InventoryStruct.ItemType);
+	NewStack.GlobalID = GenerateGlobalID();
+	NewStack.GridWidth = InventoryStruct.GridWidth;
+	NewStack.GridHeight = InventoryStruct.GridHeight;
+
+	ReserveStacks(1);
+	int32 NewIndex = ItemArray.Add(NewStack);
+
+	if (bUseGrid)
+	{
+		PlaceStackInGrid(NewIndex);
+	}
 
-	ItemArray.Add(NewStack);
+	JournalStack(InIndex);
+	JournalStack(NewIndex);
+	MarkInventoryDirty();
 
 	return true;
 }
@@ -300,6 +824,12 @@ bool UInventoryComponent::SplitStack(int32 InIndex, int32 SplitAmount)
 // Combine two item stacks
 bool UInventoryComponent::CombineStack(int32 FirstIndex, int32 SecondIndex)
 {
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	if (IsRecordingOperation())
+	{
+		Recorder->Record(*this, FString::Printf(TEXT("COMBINE %d %d"), FirstIndex, SecondIndex));
+	}
+
 	FInventoryStruct FirstInventoryStruct;
 	FInventoryStruct SecondInventoryStruct;
 
@@ -318,7 +848,8 @@ bool UInventoryComponent::CombineStack(int32 FirstIndex, int32 SecondIndex)
 	{
 		// Both stacks can be combined to one stack
 		ItemArray[FirstIndex].ItemAmount += ItemArray[SecondIndex].ItemAmount;
-		ItemArray.RemoveAt(SecondIndex);
+		JournalStack(FirstIndex);
+		RemoveStackAt(SecondIndex);
 
 		return true;
 	}
@@ -327,6 +858,9 @@ bool UInventoryComponent::CombineStack(int32 FirstIndex, int32 SecondIndex)
 		int32 Remainder = ItemArray[FirstIndex].ItemMaxAmount - ItemArray[FirstIndex].ItemAmount;
 		ItemArray[FirstIndex].ItemAmount = ItemArray[FirstIndex].ItemMaxAmount;
 		ItemArray[SecondIndex].ItemAmount -= Remainder;
+		JournalStack(FirstIndex);
+		JournalStack(SecondIndex);
+		MarkInventoryDirty();
 
 		return true;
 	}
@@ -335,12 +869,18 @@ bool UInventoryComponent::CombineStack(int32 FirstIndex, int32 SecondIndex)
 // Remove specified amount from item stack
 bool UInventoryComponent::RemoveFromStack(int32 StackIndex, int32 Amount, bool RemoveWholeStack)
 {
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	if (IsRecordingOperation())
+	{
+		Recorder->Record(*this, FString::Printf(TEXT("REMOVE %d %d %d"), StackIndex, Amount, RemoveWholeStack ? 1 : 0));
+	}
+
 	// Check if we can remove that much from this stack
 	if (Amount > ItemArray[StackIndex].ItemAmount)
 		return false;
 
 	if (RemoveWholeStack) {
-		ItemArray.RemoveAt(StackIndex);
+		RemoveStackAt(StackIndex);
 
 		return true;
 	}
@@ -348,16 +888,152 @@ bool UInventoryComponent::RemoveFromStack(int32 StackIndex, int32 Amount, bool R
 	{
 		// Remove items from stack
 		ItemArray[StackIndex].ItemAmount -= Amount;
+		MarkInventoryDirty();
 
 		// Remove stack if completely empty
 		if (ItemArray[StackIndex].ItemAmount <= 0) {
-			ItemArray.RemoveAt(StackIndex);
+			RemoveStackAt(StackIndex);
+		}
+		else {
+			JournalStack(StackIndex);
 		}
 
 		return true;
 	}
 }
 
+// Remove an amount of a class over as many stacks as needed, smallest stacks first, nothing is removed if there are not enough
+bool UInventoryComponent::ConsumeItems(TSubclassOf<class AItem> ItemClass, int32 Amount)
+{
+	if (!ItemClass || (Amount <= 0) || (GetItemCount(ItemClass) < Amount))
+		return false;
+
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	if (IsRecordingOperation())
+	{
+		Recorder->Record(*this, FString::Printf(TEXT("CONSUME %s %d"), *ItemClass->GetPathName(), Amount));
+	}
+
+	TArray<int32, TInlineAllocator<16>> StackIndices;
+	for (int32 StackIndex = 0; StackIndex < ItemArray.Num(); StackIndex++)
+	{
+		if (ItemArray[StackIndex].ItemClass == ItemClass)
+		{
+			StackIndices.Add(StackIndex);
+		}
+	}
+
+	// Emptying small stacks first frees the most slots
+	StackIndices.Sort([this](int32 One, int32 Two) {
+		const int32 OneAmount = ItemArray[One].ItemAmount;
+		const int32 TwoAmount = ItemArray[Two].ItemAmount;
+		return (OneAmount < TwoAmount) || ((OneAmount == TwoAmount) && (One < Two));
+	});
+
+	// Listeners hear about the new total once, not once per stack
+	BeginClassTotalBatch();
+
+	int32 Remaining = Amount;
+	bool bEmptiedStacks = false;
+
+	for (int32 StackIndex : StackIndices)
+	{
+		FInventoryStruct& Stack = ItemArray[StackIndex];
+		const int32 Taken = FMath::Min(Stack.ItemAmount, Remaining);
+
+		Stack.ItemAmount -= Taken;
+		Remaining -= Taken;
+
+		if (Stack.ItemAmount > 0)
+		{
+			JournalStack(StackIndex);
+		}
+		else
+		{
+			if (bUseGrid && (Stack.GridX >= 0) && (Stack.GridY >= 0))
+			{
+				Grid.Free(Stack.GridX, Stack.GridY, Stack.GridWidth, Stack.GridHeight);
+			}
+
+			JournalRemoval(Stack.UniqueID);
+			bEmptiedStacks = true;
+		}
+
+		if (Remaining == 0)
+			break;
+	}
+
+	// One pass removes all emptied stacks and keeps the order of the others
+	if (bEmptiedStacks)
+	{
+		ItemArray.RemoveAll([&ItemClass](const FInventoryStruct& Stack) {
+			return (Stack.ItemClass == ItemClass) && (Stack.ItemAmount <= 0);
+		});
+		ApplyShrinkPolicy();
+	}
+
+	MarkInventoryDirty();
+	EndClassTotalBatch();
+
+	return true;
+}
+
+// Move an amount of a stack to another inventory, merged into its open stacks, nothing moves unless all of it fits
+bool UInventoryComponent::TransferTo(UInventoryComponent* Destination, int32 UniqueID, int32 Amount)
+{
+	FInventoryStruct Stack;
+	int32 StackIndex;
+
+	if (!FindItemStackByUniqueID(UniqueID, Stack, StackIndex) || (Amount <= 0) || (Amount > Stack.ItemAmount))
+		return false;
+
+	TArray<FTransferEntry> Entries;
+	Entries.Add(FTransferEntry{ StackIndex, Amount });
+
+	return TransferEntries(Destination, Entries);
+}
+
+// Move whole stacks to another inventory in one step, all or nothing, each side tells its listeners once
+bool UInventoryComponent::TransferStacksTo(UInventoryComponent* Destination, const TArray<int32>& UniqueIDs)
+{
+	// One lookup table instead of a search per stack
+	TMap<int32, int32> IndexByUniqueID;
+	IndexByUniqueID.Reserve(ItemArray.Num());
+	for (int32 StackIndex = 0; StackIndex < ItemArray.Num(); StackIndex++)
+	{
+		IndexByUniqueID.Add(ItemArray[StackIndex].UniqueID, StackIndex);
+	}
+
+	TArray<FTransferEntry> Entries;
+	Entries.Reserve(UniqueIDs.Num());
+
+	for (int32 UniqueID : UniqueIDs)
+	{
+		// Unknown and repeated IDs fail the whole transfer
+		int32 StackIndex;
+		if (!IndexByUniqueID.RemoveAndCopyValue(UniqueID, StackIndex))
+			return false;
+
+		Entries.Add(FTransferEntry{ StackIndex, ItemArray[StackIndex].ItemAmount });
+	}
+
+	return TransferEntries(Destination, Entries);
+}
+
+// Move every stack to another inventory, all or nothing
+bool UInventoryComponent::TransferAllTo(UInventoryComponent* Destination)
+{
+	TArray<FTransferEntry> Entries;
+	Entries.Reserve(ItemArray.Num());
+
+	for (int32 StackIndex = 0; StackIndex < ItemArray.Num(); StackIndex++)
+	{
+		Entries.Add(FTransferEntry{ StackIndex, ItemArray[StackIndex].ItemAmount });
+	}
+
+	return TransferEntries(Destination, Entries);
+}
+
 // Find Item Stack by ID
 bool UInventoryComponent::FindItemStackByUniqueID(int32 InStackID, FInventoryStruct& OutStack, int32& OutIndex)
 {
@@ -418,7 +1094,7 @@ bool UInventoryComponent::FindStackByClass(TSubclassOf<class AItem> StackClass,
 
 // Search Item Stack by Index
 bool UInventoryComponent::FindStackByIndex(int32 Index, FInventoryStruct& outStructure) {
-	if ((Index < 0) || (Index > ItemArray.Num()))
+	if ((Index < 0) || (Index >= ItemArray.Num()))
 		return false;
 
 	outStructure = this->ItemArray[Index];
@@ -452,72 +1128,1493 @@ int32 UInventoryComponent::CalculateStackWeight(FInventoryStruct& InStack)
 	return OutWeight;
 }
 
-// Calculate a unique stack ID
-int32 UInventoryComponent::CalculateUniqueID()
+// Amount of items with a tag or one of its child tags, O(1)
+int32 UInventoryComponent::GetItemCountWithTag(FGameplayTag Tag) const
 {
-	int32 OutUniqueID = -1;
+	EnsureAggregates();
 
-	OutUniqueID = ++UniqueIDCounter;
-	
-	return OutUniqueID;
+	const int32 Bit = AggregatedDatabase ? AggregatedDatabase->GetTagBit(Tag) : INDEX_NONE;
+
+	return TagTotals.IsValidIndex(Bit) ? TagTotals[Bit] : 0;
 }
 
-// Sort all items in the inventory based on given sort method
-bool UInventoryComponent::SortInventory(ESortMethod SortMethod)
+// Check if any item matches the query
+bool UInventoryComponent::HasItemMatching(const FInventoryTagQuery& Query) const
 {
-	switch (SortMethod)
+	EnsureAggregates();
+
+	if (!AggregatedDatabase)
+		return false;
+
+	const FInventoryCompiledTagQuery Compiled = AggregatedDatabase->CompileQuery(Query);
+
+	// Tags no item in here has rule the query out without looking at any class
+	if (Compiled.bNeverMatches || !PresentTagBits.HasAll(Compiled.All) || (!Compiled.Any.IsEmpty() && !PresentTagBits.HasAny(Compiled.Any)))
+		return false;
+
+	for (const TPair<UClass*, int32>& ClassTotal : ClassTotals)
 	{
-	case ESortMethod::NAME :
+		if (Compiled.Matches(AggregatedDatabase->GetClassBits(ClassTotal.Key)))
+			return true;
+	}
+
+	return false;
+}
+
+// Amount of items matching the query
+int32 UInventoryComponent::GetItemCountMatching(const FInventoryTagQuery& Query) const
+{
+	EnsureAggregates();
+
+	if (!AggregatedDatabase)
+		return 0;
+
+	const FInventoryCompiledTagQuery Compiled = AggregatedDatabase->CompileQuery(Query);
+	if (Compiled.bNeverMatches || !PresentTagBits.HasAll(Compiled.All))
+		return 0;
+
+	int32 Count = 0;
+	for (const TPair<UClass*, int32>& ClassTotal : ClassTotals)
 	{
-		SortInventoryByName();
+		if (Compiled.Matches(AggregatedDatabase->GetClassBits(ClassTotal.Key)))
+		{
+			Count += ClassTotal.Value;
+		}
 	}
-	break;
 
-	case ESortMethod::WEIGHT :
+	return Count;
+}
+
+// Unique IDs of all stacks matching the query
+void UInventoryComponent::FindStacksMatching(const FInventoryTagQuery& Query, TArray<int32>& OutUniqueIDs) const
+{
+	OutUniqueIDs.Reset();
+
+	if (!ItemDatabase)
+		return;
+
+	const FInventoryCompiledTagQuery Compiled = ItemDatabase->CompileQuery(Query);
+	if (Compiled.bNeverMatches)
+		return;
+
+	for (const FInventoryStruct& Stack : ItemArray)
 	{
-		SortInventoryByWeight();
+		if (Compiled.Matches(ItemDatabase->GetClassBits(Stack.ItemClass)))
+		{
+			OutUniqueIDs.Add(Stack.UniqueID);
+		}
 	}
-	break;
+}
 
-	case ESortMethod::AMOUNT :
+// Amount of items of a class over all stacks, O(1)
+int32 UInventoryComponent::GetItemCount(TSubclassOf<AItem> ItemClass) const
+{
+	EnsureAggregates();
+
+	const int32* ClassTotal = ClassTotals.Find(ItemClass);
+	return ClassTotal ? *ClassTotal : 0;
+}
+
+// Count a changed stack in the class and tag totals
+void UInventoryComponent::UpdateStackAggregates(const FInventoryStruct& Stack)
+{
+	if (!bAggregatesValid)
+		return;
+
+	FAggregatedStack* Aggregated = AggregatedStacks.Find(Stack.UniqueID);
+	if (!Aggregated)
 	{
-		SortInventoryByAmount();
+		Aggregated = &AggregatedStacks.Add(Stack.UniqueID, FAggregatedStack{ nullptr, 0 });
 	}
-	break;
 
-	default:
+	// A stack only changes class when its ID is reused, count that as removal and addition
+	if (Aggregated->ItemClass != *Stack.ItemClass)
 	{
-		SortInventoryByPriority();
+		ApplyAggregateDelta(Aggregated->ItemClass, -Aggregated->Amount);
+		Aggregated->ItemClass = *Stack.ItemClass;
+		Aggregated->Amount = 0;
 	}
-	break;
+
+	const int32 Delta = Stack.ItemAmount - Aggregated->Amount;
+	Aggregated->Amount = Stack.ItemAmount;
+	ApplyAggregateDelta(Aggregated->ItemClass, Delta);
+}
+
+// Take a removed stack out of the class and tag totals
+void UInventoryComponent::RemoveStackAggregates(int32 UniqueID)
+{
+	if (!bAggregatesValid)
+		return;
+
+	FAggregatedStack Aggregated;
+	if (AggregatedStacks.RemoveAndCopyValue(UniqueID, Aggregated))
+	{
+		ApplyAggregateDelta(Aggregated.ItemClass, -Aggregated.Amount);
 	}
-	return true;
 }
 
-void UInventoryComponent::SortInventoryByName()
+// Catch up with an array that was replaced as a whole, listeners only hear about classes whose total changed
+void UInventoryComponent::SyncAggregates()
 {
-	ItemArray.Sort([](const FInventoryStruct& One, const FInventoryStruct& Two) {
-		return One.ItemName.ToString() < Two.ItemName.ToString();
-	});
+	if (!bAggregatesValid)
+		return;
+
+	TSet<int32> RemainingIDs;
+	RemainingIDs.Reserve(ItemArray.Num());
+
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		RemainingIDs.Add(Stack.UniqueID);
+		UpdateStackAggregates(Stack);
+	}
+
+	TArray<int32> RemovedIDs;
+	for (const TPair<int32, FAggregatedStack>& Aggregated : AggregatedStacks)
+	{
+		if (!RemainingIDs.Contains(Aggregated.Key))
+		{
+			RemovedIDs.Add(Aggregated.Key);
+		}
+	}
+
+	for (int32 UniqueID : RemovedIDs)
+	{
+		RemoveStackAggregates(UniqueID);
+	}
 }
 
-void UInventoryComponent::SortInventoryByWeight()
+// Add an amount change of a class to the class and tag totals and tell listeners
+void UInventoryComponent::ApplyAggregateDelta(UClass* ItemClass, int32 Delta)
 {
-	ItemArray.Sort([](const FInventoryStruct& One, const FInventoryStruct& Two) {
-		return One.ItemWeight < Two.ItemWeight;
-	});
+	if (!ItemClass || (Delta == 0))
+		return;
+
+	int32& ClassTotal = ClassTotals.FindOrAdd(ItemClass);
+	ClassTotal += Delta;
+
+	const int32 NewTotal = ClassTotal;
+	if (NewTotal == 0)
+	{
+		ClassTotals.Remove(ItemClass);
+	}
+
+	// Tag totals of an outdated database are rebuilt on the next tag query instead
+	if (AreTagTotalsCurrent())
+	{
+		AddToTagTotals(ItemClass, Delta);
+	}
+	else
+	{
+		bTagTotalsValid = false;
+	}
+
+	if (ClassTotalBatchDepth > 0)
+	{
+		BatchedTotalClasses.AddUnique(ItemClass);
+		return;
+	}
+
+	OnClassTotalChanged.Broadcast(ItemClass, NewTotal);
 }
 
-void UInventoryComponent::SortInventoryByAmount()
+// Add an amount change of a class to the totals of its tags
+void UInventoryComponent::AddToTagTotals(const UClass* ItemClass, int32 Delta) const
 {
-	ItemArray.Sort([](const FInventoryStruct& One, const FInventoryStruct& Two) {
-		return One.ItemAmount < Two.ItemAmount;
+	if (!AggregatedDatabase)
+		return;
+
+	AggregatedDatabase->GetClassBits(ItemClass).ForEachSetBit([this, Delta](int32 Bit)
+	{
+		TagTotals[Bit] += Delta;
+
+		if (TagTotals[Bit] > 0)
+		{
+			PresentTagBits.SetBit(Bit);
+		}
+		else
+		{
+			PresentTagBits.ClearBit(Bit);
+		}
 	});
 }
 
-void UInventoryComponent::SortInventoryByPriority()
+// Build the totals if they are not kept yet, and the tag totals again after the database changed
+void UInventoryComponent::EnsureAggregates() const
 {
-	ItemArray.Sort([](const FInventoryStruct& One, const FInventoryStruct& Two) {
-		return One.SortPriority < Two.SortPriority;
-	});
-}
\ No newline at end of file
+	if (!bAggregatesValid)
+	{
+		AggregatedStacks.Reset();
+		ClassTotals.Reset();
+
+		for (const FInventoryStruct& Stack : ItemArray)
+		{
+			AggregatedStacks.Add(Stack.UniqueID, FAggregatedStack{ *Stack.ItemClass, Stack.ItemAmount });
+
+			if (Stack.ItemClass && (Stack.ItemAmount != 0))
+			{
+				ClassTotals.FindOrAdd(*Stack.ItemClass) += Stack.ItemAmount;
+			}
+		}
+
+		bAggregatesValid = true;
+		bTagTotalsValid = false;
+	}
+
+	if (AreTagTotalsCurrent())
+		return;
+
+	AggregatedDatabase = ItemDatabase;
+	AggregatedDatabaseVersion = ItemDatabase ? ItemDatabase->GetVersion() : 0;
+	TagTotals.Reset();
+	TagTotals.SetNumZeroed(ItemDatabase ? ItemDatabase->GetNumTagBits() : 0);
+	PresentTagBits.Words.Reset();
+
+	for (const TPair<UClass*, int32>& ClassTotal : ClassTotals)
+	{
+		AddToTagTotals(ClassTotal.Key, ClassTotal.Value);
+	}
+
+	bTagTotalsValid = true;
+}
+
+// The tag totals were built with the current database and version
+bool UInventoryComponent::AreTagTotalsCurrent() const
+{
+	// An edited database compiles to a new version with other bits
+	return bTagTotalsValid && (AggregatedDatabase == ItemDatabase) && (!ItemDatabase || (ItemDatabase->GetVersion() == AggregatedDatabaseVersion));
+}
+
+// Check that all entries fit into the destination, then move them, nothing changes if any of them does not fit
+bool UInventoryComponent::TransferEntries(UInventoryComponent* Destination, const TArray<FTransferEntry>& Entries)
+{
+	if (!Destination || (Destination == this) || (Entries.Num() == 0))
+		return false;
+
+	// Weight of everything that moves against the free weight of the destination
+	int64 MovedWeight = 0;
+	for (const FTransferEntry& Entry : Entries)
+	{
+		const FInventoryStruct& Stack = ItemArray[Entry.SourceIndex];
+		if (Stack.ItemWeight > 0)
+		{
+			MovedWeight += (int64)Stack.ItemWeight * Entry.Amount;
+		}
+	}
+
+	if ((MovedWeight > 0) && (Destination->CalculateInventoryWeight() + MovedWeight > Destination->MaxIntentoryWeight))
+	{
+		Destination->OnOutOfSpace.Broadcast();
+		return false;
+	}
+
+	// Room left in the open stacks of the destination, filled in array order like a pickup
+	struct FOpenStack
+	{
+		int32 Index;
+		int32 Room;
+	};
+
+	struct FOpenStacks
+	{
+		TArray<FOpenStack, TInlineAllocator<4>> Stacks;
+		int32 Cursor = 0;
+	};
+
+	TMap<UClass*, FOpenStacks> OpenStacksByClass;
+	for (int32 Index = 0; Index < Destination->ItemArray.Num(); Index++)
+	{
+		const FInventoryStruct& Stack = Destination->ItemArray[Index];
+		if ((Stack.ItemMaxAmount > 0) && (Stack.ItemAmount < Stack.ItemMaxAmount))
+		{
+			OpenStacksByClass.FindOrAdd(Stack.ItemClass).Stacks.Add(FOpenStack{ Index, Stack.ItemMaxAmount - Stack.ItemAmount });
+		}
+	}
+
+	struct FMerge
+	{
+		int32 DestinationIndex;
+		int32 Amount;
+	};
+
+	// Plan the merges first, what is left of an entry becomes one new stack
+	TArray<FMerge> Merges;
+	TArray<int32> NewStackAmounts;
+	NewStackAmounts.SetNumUninitialized(Entries.Num());
+
+	for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); EntryIndex++)
+	{
+		const FTransferEntry& Entry = Entries[EntryIndex];
+		const FInventoryStruct& Stack = ItemArray[Entry.SourceIndex];
+		int32 RemainingAmount = Entry.Amount;
+
+		FOpenStacks* OpenStacks = (Stack.ItemMaxAmount > 0) ? OpenStacksByClass.Find(Stack.ItemClass) : nullptr;
+		while (OpenStacks && (RemainingAmount > 0) && (OpenStacks->Cursor < OpenStacks->Stacks.Num()))
+		{
+			FOpenStack& OpenStack = OpenStacks->Stacks[OpenStacks->Cursor];
+			const int32 MergedAmount = FMath::Min(OpenStack.Room, RemainingAmount);
+
+			Merges.Add(FMerge{ OpenStack.Index, MergedAmount });
+			OpenStack.Room -= MergedAmount;
+			RemainingAmount -= MergedAmount;
+
+			if (OpenStack.Room == 0)
+			{
+				OpenStacks->Cursor++;
+			}
+		}
+
+		NewStackAmounts[EntryIndex] = RemainingAmount;
+	}
+
+	// New stacks need free cells in a grid destination, taken cells are given back if one does not fit
+	TArray<FIntPoint> NewStackCells;
+	if (Destination->bUseGrid)
+	{
+		NewStackCells.SetNumUninitialized(Entries.Num());
+		TArray<int32> PlacedEntries;
+
+		for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); EntryIndex++)
+		{
+			if (NewStackAmounts[EntryIndex] <= 0)
+				continue;
+
+			const FInventoryStruct& Stack = ItemArray[Entries[EntryIndex].SourceIndex];
+			FIntPoint& Cell = NewStackCells[EntryIndex];
+
+			if (!Destination->FindGridPosition(Stack.GridWidth, Stack.GridHeight, Cell.X, Cell.Y))
+			{
+				for (int32 PlacedEntry : PlacedEntries)
+				{
+					const FInventoryStruct& PlacedStack = ItemArray[Entries[PlacedEntry].SourceIndex];
+					Destination->Grid.Free(NewStackCells[PlacedEntry].X, NewStackCells[PlacedEntry].Y, PlacedStack.GridWidth, PlacedStack.GridHeight);
+				}
+
+				Destination->OnOutOfSpace.Broadcast();
+				return false;
+			}
+
+			Destination->Grid.Occupy(Cell.X, Cell.Y, Stack.GridWidth, Stack.GridHeight);
+			PlacedEntries.Add(EntryIndex);
+		}
+	}
+
+	// Everything fits, from here on the transfer can't fail
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	TGuardValue<int32> DestinationOperationGuard(Destination->OperationDepth, Destination->OperationDepth + 1);
+
+	// The new stacks of the destination, complete with IDs so the recording can name them
+	TArray<FInventoryStruct> NewStacks;
+	for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); EntryIndex++)
+	{
+		if (NewStackAmounts[EntryIndex] <= 0)
+			continue;
+
+		const FTransferEntry& Entry = Entries[EntryIndex];
+		FInventoryStruct& NewStack = NewStacks[NewStacks.Add(ItemArray[Entry.SourceIndex])];
+		NewStack.ItemAmount = NewStackAmounts[EntryIndex];
+		NewStack.UniqueID = Destination->CalculateUniqueID();
+		NewStack.GridX = Destination->bUseGrid ? NewStackCells[EntryIndex].X : -1;
+		NewStack.GridY = Destination->bUseGrid ? NewStackCells[EntryIndex].Y : -1;
+
+		// A moved stack keeps its global identity, a split off part is a stack of its own
+		if (Entry.Amount < ItemArray[Entry.SourceIndex].ItemAmount)
+		{
+			NewStack.GlobalID = Destination->GenerateGlobalID();
+		}
+	}
+
+	// The source replays as removals, from the back so earlier indices stay valid
+	if (IsRecordingOperation())
+	{
+		TArray<FTransferEntry> SortedEntries = Entries;
+		SortedEntries.Sort([](const FTransferEntry& One, const FTransferEntry& Two) { return One.SourceIndex > Two.SourceIndex; });
+
+		for (const FTransferEntry& Entry : SortedEntries)
+		{
+			Recorder->Record(*this, FString::Printf(TEXT("REMOVE %d %d 0"), Entry.SourceIndex, Entry.Amount));
+		}
+	}
+
+	// The destination replays the exact layout: TRANSFER <merges> <new stacks>, then index and amount of every merge, then class, amount, ID and cell of every new stack
+	if (Destination->IsRecordingOperation())
+	{
+		FString Operation = FString::Printf(TEXT("TRANSFER %d %d"), Merges.Num(), NewStacks.Num());
+
+		for (const FMerge& Merge : Merges)
+		{
+			Operation += FString::Printf(TEXT(" %d %d"), Merge.DestinationIndex, Merge.Amount);
+		}
+
+		for (const FInventoryStruct& NewStack : NewStacks)
+		{
+			Operation += FString::Printf(TEXT(" %s %d %d %d %d"), *GetPathNameSafe(NewStack.ItemClass), NewStack.ItemAmount, NewStack.UniqueID, NewStack.GridX, NewStack.GridY);
+		}
+
+		Destination->Recorder->Record(*Destination, Operation);
+	}
+
+	// Listeners of both sides hear about the new totals once
+	BeginClassTotalBatch();
+	Destination->BeginClassTotalBatch();
+
+	TBitArray<> MergedStacks(false, Destination->ItemArray.Num());
+	for (const FMerge& Merge : Merges)
+	{
+		Destination->ItemArray[Merge.DestinationIndex].ItemAmount += Merge.Amount;
+		MergedStacks[Merge.DestinationIndex] = true;
+	}
+
+	for (TConstSetBitIterator<> It(MergedStacks); It; ++It)
+	{
+		Destination->JournalStack(It.GetIndex());
+	}
+
+	Destination->ReserveStacks(NewStacks.Num());
+
+	for (const FInventoryStruct& NewStack : NewStacks)
+	{
+		const int32 NewIndex = Destination->ItemArray.Add(NewStack);
+		Destination->JournalStack(NewIndex);
+	}
+
+	// Only the transferred stacks may go, stacks that were empty before are none of the transfer's business
+	TBitArray<> EmptiedStacks(false, ItemArray.Num());
+	bool bEmptiedStacks = false;
+	for (const FTransferEntry& Entry : Entries)
+	{
+		FInventoryStruct& Stack = ItemArray[Entry.SourceIndex];
+		Stack.ItemAmount -= Entry.Amount;
+
+		if (Stack.ItemAmount > 0)
+		{
+			JournalStack(Entry.SourceIndex);
+			continue;
+		}
+
+		if (bUseGrid && (Stack.GridX >= 0) && (Stack.GridY >= 0))
+		{
+			Grid.Free(Stack.GridX, Stack.GridY, Stack.GridWidth, Stack.GridHeight);
+		}
+
+		JournalRemoval(Stack.UniqueID);
+		EmptiedStacks[Entry.SourceIndex] = true;
+		bEmptiedStacks = true;
+	}
+
+	// One pass removes all moved stacks and keeps the order of the others
+	if (bEmptiedStacks)
+	{
+		int32 WriteIndex = 0;
+		for (int32 ReadIndex = 0; ReadIndex < ItemArray.Num(); ReadIndex++)
+		{
+			if (EmptiedStacks[ReadIndex])
+				continue;
+
+			if (WriteIndex != ReadIndex)
+			{
+				ItemArray[WriteIndex] = MoveTemp(ItemArray[ReadIndex]);
+			}
+			WriteIndex++;
+		}
+
+		ItemArray.SetNum(WriteIndex, false);
+		ApplyShrinkPolicy();
+	}
+
+	MarkInventoryDirty();
+	Destination->MarkInventoryDirty();
+
+	Destination->EndClassTotalBatch();
+	EndClassTotalBatch();
+
+	return true;
+}
+
+// Hold back class total notifications until the matching EndClassTotalBatch
+void UInventoryComponent::BeginClassTotalBatch()
+{
+	ClassTotalBatchDepth++;
+}
+
+// Tell listeners once about every class whose total changed during the batch
+void UInventoryComponent::EndClassTotalBatch()
+{
+	check(ClassTotalBatchDepth > 0);
+	if (--ClassTotalBatchDepth > 0)
+		return;
+
+	// Listeners may start a new batch
+	TArray<UClass*, TInlineAllocator<4>> ChangedClasses = MoveTemp(BatchedTotalClasses);
+	BatchedTotalClasses.Reset();
+
+	for (UClass* ItemClass : ChangedClasses)
+	{
+		OnClassTotalChanged.Broadcast(ItemClass, ClassTotals.FindRef(ItemClass));
+	}
+}
+
+// Global ID of a stack, 0 if there is no stack with this unique ID
+int64 UInventoryComponent::GetGlobalStackID(int32 InStackID) const
+{
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		if (Stack.UniqueID == InStackID)
+			return Stack.GlobalID;
+	}
+
+	return 0;
+}
+
+// Unique ID of the stack with a global ID in this inventory, -1 if it is not here
+int32 UInventoryComponent::FindUniqueIDByGlobalID(int64 GlobalID) const
+{
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		if (Stack.GlobalID == GlobalID)
+			return Stack.UniqueID;
+	}
+
+	return -1;
+}
+
+// Global ID of a stack as text, Blueprints have no 64 bit integers
+FString UInventoryComponent::GetGlobalStackIDString(int32 InStackID) const
+{
+	return FString::Printf(TEXT("%016llX"), (uint64)GetGlobalStackID(InStackID));
+}
+
+// Calculate a unique stack ID
+int32 UInventoryComponent::CalculateUniqueID()
+{
+	int32 OutUniqueID = -1;
+
+	OutUniqueID = ++UniqueIDCounter;
+	
+	return OutUniqueID;
+}
+
+// Global ID of a stack created in this inventory, 0 without authority, the server's ID arrives with its state
+int64 UInventoryComponent::GenerateGlobalID() const
+{
+	// Clients never take blocks, so they never write the high water mark either
+	const AActor* Owner = GetOwner();
+	return (Owner && Owner->HasAuthority()) ? FInventoryStackIdGenerator::Generate() : 0;
+}
+
+// Sort all items in the inventory based on given sort method
+bool UInventoryComponent::SortInventory(ESortMethod SortMethod)
+{
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	if (IsRecordingOperation())
+	{
+		Recorder->Record(*this, FString::Printf(TEXT("SORT %d"), (int32)SortMethod));
+	}
+
+	switch (SortMethod)
+	{
+	case ESortMethod::NAME :
+	{
+		SortInventoryByName();
+	}
+	break;
+
+	case ESortMethod::WEIGHT :
+	{
+		SortInventoryByWeight();
+	}
+	break;
+
+	case ESortMethod::AMOUNT :
+	{
+		SortInventoryByAmount();
+	}
+	break;
+
+	default:
+	{
+		SortInventoryByPriority();
+	}
+	break;
+	}
+
+	// Lay the grid out in the new order, fall back to packing largest stacks first if that does not fit
+	if (bUseGrid && !RepackGrid(false))
+	{
+		RepackGrid(true);
+	}
+
+	NotifyOrderChanged();
+
+	MarkInventoryDirty();
+
+	return true;
+}
+
+void UInventoryComponent::SortInventoryByName()
+{
+	ItemArray.Sort([](const FInventoryStruct& One, const FInventoryStruct& Two) {
+		return One.ItemName.ToString() < Two.ItemName.ToString();
+	});
+}
+
+void UInventoryComponent::SortInventoryByWeight()
+{
+	ItemArray.Sort([](const FInventoryStruct& One, const FInventoryStruct& Two) {
+		return One.ItemWeight < Two.ItemWeight;
+	});
+}
+
+void UInventoryComponent::SortInventoryByAmount()
+{
+	ItemArray.Sort([](const FInventoryStruct& One, const FInventoryStruct& Two) {
+		return One.ItemAmount < Two.ItemAmount;
+	});
+}
+
+void UInventoryComponent::SortInventoryByPriority()
+{
+	ItemArray.Sort([](const FInventoryStruct& One, const FInventoryStruct& Two) {
+		return One.SortPriority < Two.SortPriority;
+	});
+}
+
+// Rebuild grid occupancy from the stacks
+void UInventoryComponent::RebuildGrid()
+{
+	Grid.Init(GridColumns, GridRows);
+
+	// Keep valid positions, collect stacks that have none or overlap others
+	TArray<int32> UnplacedIndices;
+	for (int32 Index = 0; Index < ItemArray.Num(); Index++)
+	{
+		FInventoryStruct& Stack = ItemArray[Index];
+		if (Grid.Fits(Stack.GridX, Stack.GridY, Stack.GridWidth, Stack.GridHeight))
+		{
+			Grid.Occupy(Stack.GridX, Stack.GridY, Stack.GridWidth, Stack.GridHeight);
+		}
+		else
+		{
+			Stack.GridX = -1;
+			Stack.GridY = -1;
+			UnplacedIndices.Add(Index);
+		}
+	}
+
+	for (int32 Index : UnplacedIndices)
+	{
+		PlaceStackInGrid(Index);
+	}
+}
+
+// Repack all stacks, largest first
+bool UInventoryComponent::ArrangeGrid()
+{
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	if (IsRecordingOperation())
+	{
+		Recorder->Record(*this, TEXT("ARRANGE"));
+	}
+
+	if (!bUseGrid)
+		return false;
+
+	return RepackGrid(true);
+}
+
+// Check if a stack could be moved to a grid position
+bool UInventoryComponent::CanPlaceStackAt(int32 StackIndex, int32 X, int32 Y)
+{
+	if (!bUseGrid || !ItemArray.IsValidIndex(StackIndex))
+		return false;
+
+	FInventoryStruct& Stack = ItemArray[StackIndex];
+	bool bPlaced = (Stack.GridX >= 0) && (Stack.GridY >= 0);
+
+	// Ignore the cells of the stack itself
+	if (bPlaced)
+	{
+		Grid.Free(Stack.GridX, Stack.GridY, Stack.GridWidth, Stack.GridHeight);
+	}
+
+	bool bFits = Grid.Fits(X, Y, Stack.GridWidth, Stack.GridHeight);
+
+	if (bPlaced)
+	{
+		Grid.Occupy(Stack.GridX, Stack.GridY, Stack.GridWidth, Stack.GridHeight);
+	}
+
+	return bFits;
+}
+
+// Move a stack to a grid position
+bool UInventoryComponent::MoveStackInGrid(int32 StackIndex, int32 X, int32 Y)
+{
+	TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+	if (IsRecordingOperation())
+	{
+		Recorder->Record(*this, FString::Printf(TEXT("MOVE %d %d %d"), StackIndex, X, Y));
+	}
+
+	if (!CanPlaceStackAt(StackIndex, X, Y))
+		return false;
+
+	FInventoryStruct& Stack = ItemArray[StackIndex];
+	if (Stack.GridX >= 0)
+	{
+		Grid.Free(Stack.GridX, Stack.GridY, Stack.GridWidth, Stack.GridHeight);
+	}
+
+	Stack.GridX = X;
+	Stack.GridY = Y;
+	Grid.Occupy(X, Y, Stack.GridWidth, Stack.GridHeight);
+	JournalStack(StackIndex);
+	MarkInventoryDirty();
+
+	return true;
+}
+
+// Find a grid position for a stack size using the configured placement
+bool UInventoryComponent::FindGridPosition(int32 Width, int32 Height, int32& OutX, int32& OutY)
+{
+	if (GridPlacement == EGridPlacement::BEST_FIT)
+	{
+		return Grid.FindBestFit(Width, Height, OutX, OutY);
+	}
+
+	return Grid.FindFirstFit(Width, Height, OutX, OutY);
+}
+
+// Find a grid position for a stack and occupy it
+bool UInventoryComponent::PlaceStackInGrid(int32 StackIndex)
+{
+	FInventoryStruct& Stack = ItemArray[StackIndex];
+	int32 GridX, GridY;
+
+	if (!FindGridPosition(Stack.GridWidth, Stack.GridHeight, GridX, GridY))
+	{
+		Stack.GridX = -1;
+		Stack.GridY = -1;
+
+		return false;
+	}
+
+	Stack.GridX = GridX;
+	Stack.GridY = GridY;
+	Grid.Occupy(GridX, GridY, Stack.GridWidth, Stack.GridHeight);
+
+	return true;
+}
+
+// Remove a stack from the array and free its grid cells
+void UInventoryComponent::RemoveStackAt(int32 StackIndex)
+{
+	const FInventoryStruct& Stack = ItemArray[StackIndex];
+	if (bUseGrid && (Stack.GridX >= 0) && (Stack.GridY >= 0))
+	{
+		Grid.Free(Stack.GridX, Stack.GridY, Stack.GridWidth, Stack.GridHeight);
+	}
+
+	// Removed before the record is written, a snapshot never holds a stack whose removal it supersedes
+	const int32 UniqueID = Stack.UniqueID;
+	ItemArray.RemoveAt(StackIndex, 1, false);
+	JournalRemoval(UniqueID);
+
+	ApplyShrinkPolicy();
+	MarkInventoryDirty();
+}
+
+// Make room for new stacks, the first allocation covers MinStackCapacity at once
+void UInventoryComponent::ReserveStacks(int32 NumNewStacks)
+{
+	if (NumNewStacks <= 0)
+		return;
+
+	ItemArray.Reserve(FMath::Max(ItemArray.Num() + NumNewStacks, MinStackCapacity));
+}
+
+// Release stack capacity after large removals
+void UInventoryComponent::ApplyShrinkPolicy()
+{
+	const int32 Capacity = ItemArray.Max();
+	if ((Capacity <= MinStackCapacity) || (ItemArray.Num() * ShrinkFactor >= Capacity))
+		return;
+
+	// Keep room to grow again so add and remove at the threshold don't reallocate every time
+	TArray<FInventoryStruct> Compacted;
+	Compacted.Reserve(FMath::Max(ItemArray.Num() * 2, MinStackCapacity));
+	Compacted.Append(MoveTemp(ItemArray));
+	ItemArray = MoveTemp(Compacted);
+}
+
+// Place all stacks again, restores the old layout if not everything fits
+bool UInventoryComponent::RepackGrid(bool bLargestFirst)
+{
+	TArray<int32> Order;
+	TArray<FIntPoint> OldPositions;
+	Order.Reserve(ItemArray.Num());
+	OldPositions.Reserve(ItemArray.Num());
+
+	for (int32 Index = 0; Index < ItemArray.Num(); Index++)
+	{
+		Order.Add(Index);
+		OldPositions.Add(FIntPoint(ItemArray[Index].GridX, ItemArray[Index].GridY));
+	}
+
+	if (bLargestFirst)
+	{
+		Order.StableSort([this](int32 One, int32 Two) {
+			return ItemArray[One].GridWidth * ItemArray[One].GridHeight > ItemArray[Two].GridWidth * ItemArray[Two].GridHeight;
+		});
+	}
+
+	Grid.Init(GridColumns, GridRows);
+
+	for (int32 Index : Order)
+	{
+		if (!PlaceStackInGrid(Index))
+		{
+			// Restore the previous layout
+			for (int32 RestoreIndex = 0; RestoreIndex < ItemArray.Num(); RestoreIndex++)
+			{
+				ItemArray[RestoreIndex].GridX = OldPositions[RestoreIndex].X;
+				ItemArray[RestoreIndex].GridY = OldPositions[RestoreIndex].Y;
+			}
+
+			RebuildGrid();
+
+			return false;
+		}
+	}
+
+	// Only positions changed, the journal gets them in one record
+	for (int32 Index = 0; Index < ItemArray.Num(); Index++)
+	{
+		PublishStack(Index);
+	}
+
+	JournalCells();
+
+	MarkInventoryDirty();
+
+	return true;
+}
+
+// Split a stack, predicted on the owning client and batched to the server
+bool UInventoryComponent::RequestSplitStack(int32 UniqueID, int32 SplitAmount)
+{
+	return SubmitCommand(FInventoryCommand(EInventoryCommandType::SPLIT, UniqueID, CalculateUniqueID(), SplitAmount, 0));
+}
+
+// Combine the second stack into the first
+bool UInventoryComponent::RequestCombineStack(int32 FirstUniqueID, int32 SecondUniqueID)
+{
+	return SubmitCommand(FInventoryCommand(EInventoryCommandType::COMBINE, FirstUniqueID, SecondUniqueID, 0, 0));
+}
+
+// Move a stack to a grid position or array index
+bool UInventoryComponent::RequestMoveStack(int32 UniqueID, int32 X, int32 Y)
+{
+	return SubmitCommand(FInventoryCommand(EInventoryCommandType::MOVE, UniqueID, -1, X, Y));
+}
+
+// Drop a whole stack
+bool UInventoryComponent::RequestDropStack(int32 UniqueID)
+{
+	return SubmitCommand(FInventoryCommand(EInventoryCommandType::DROP, UniqueID, -1, 0, 0));
+}
+
+// Use one item of a stack
+bool UInventoryComponent::RequestUseStack(int32 UniqueID)
+{
+	// The client predicts the cooldown once here, replays of the command after a server update must not check it again
+	AActor* Owner = GetOwner();
+	if (Owner && !Owner->HasAuthority())
+	{
+		FInventoryStruct Stack;
+		int32 StackIndex;
+
+		if (!FindItemStackByUniqueID(UniqueID, Stack, StackIndex) || !TryStartUseCooldown(Stack.ItemClass))
+			return false;
+	}
+
+	return SubmitCommand(FInventoryCommand(EInventoryCommandType::USE, UniqueID, -1, 0, 0));
+}
+
+// Predict locally and queue for the server, or execute directly with authority
+bool UInventoryComponent::SubmitCommand(FInventoryCommand Command)
+{
+	AActor* Owner = GetOwner();
+	if (!Owner || Owner->HasAuthority())
+	{
+		return ExecuteCommand(Command, false);
+	}
+
+	// Rejected predictions are never sent
+	if (!ExecuteCommand(Command, true))
+		return false;
+
+	Command.Sequence = ++LastSubmittedSequence;
+	PendingCommands.Add(Command);
+	OutgoingCommands.Add(Command);
+
+	return true;
+}
+
+// Apply one command to ItemArray
+bool UInventoryComponent::ExecuteCommand(const FInventoryCommand& Command, bool bPredicted)
+{
+	FInventoryStruct Stack;
+	int32 StackIndex;
+
+	if (!FindItemStackByUniqueID(Command.UniqueID, Stack, StackIndex))
+		return false;
+
+	switch (Command.Type)
+	{
+	case EInventoryCommandType::SPLIT :
+	{
+		// Keep the ID the client predicted so later commands can address the new stack
+		FInventoryStruct ExistingStack;
+		int32 ExistingIndex;
+		int32 NewUniqueID = Command.OtherUniqueID;
+
+		if (!IsPredictedUniqueIDValid(NewUniqueID) || FindItemStackByUniqueID(NewUniqueID, ExistingStack, ExistingIndex))
+		{
+			NewUniqueID = CalculateUniqueID();
+		}
+
+		UniqueIDCounter = FMath::Max(UniqueIDCounter, NewUniqueID);
+
+		return SplitStackWithID(StackIndex, Command.Amount, NewUniqueID);
+	}
+
+	case EInventoryCommandType::COMBINE :
+	{
+		FInventoryStruct OtherStack;
+		int32 OtherIndex;
+
+		if ((Command.OtherUniqueID == Command.UniqueID) || !FindItemStackByUniqueID(Command.OtherUniqueID, OtherStack, OtherIndex))
+			return false;
+
+		return CombineStack(StackIndex, OtherIndex);
+	}
+
+	case EInventoryCommandType::MOVE :
+	{
+		if (bUseGrid)
+		{
+			return MoveStackInGrid(StackIndex, Command.Amount, Command.Target);
+		}
+
+		// Without grid a move reorders the array
+		if (!ItemArray.IsValidIndex(Command.Amount))
+			return false;
+
+		TGuardValue<int32> OperationGuard(OperationDepth, OperationDepth + 1);
+		if (IsRecordingOperation())
+		{
+			Recorder->Record(*this, FString::Printf(TEXT("REORDER %d %d"), StackIndex, Command.Amount));
+		}
+
+		ItemArray.RemoveAt(StackIndex, 1, false);
+		ItemArray.Insert(Stack, Command.Amount);
+		MarkInventoryDirty();
+
+		NotifyOrderChanged();
+
+		return true;
+	}
+
+	case EInventoryCommandType::DROP :
+	{
+		// Only the server spawns the dropped item
+		if (bPredicted)
+		{
+			RemoveStackAt(StackIndex);
+
+			return true;
+		}
+
+		return DropItem(Stack);
+	}
+
+	case EInventoryCommandType::USE :
+	{
+		// Only the server runs the use event
+		if (bPredicted)
+		{
+			return RemoveFromStack(StackIndex, 1, false);
+		}
+
+		return UseStackAt(StackIndex);
+	}
+	}
+
+	return false;
+}
+
+// Whether the server can adopt a split ID predicted by the client
+bool UInventoryComponent::IsPredictedUniqueIDValid(int32 PredictedUniqueID) const
+{
+	// Computed in 64 bit so a counter close to the limit can not wrap around
+	return (PredictedUniqueID > 0) && ((int64)PredictedUniqueID <= (int64)UniqueIDCounter + MaxPredictedUniqueIDs);
+}
+
+bool UInventoryComponent::ServerExecuteCommands_Validate(const TArray<FInventoryCommand>& Commands)
+{
+	if (Commands.Num() > MaxCommandsPerBatch)
+		return false;
+
+	// A well behaved client never predicts IDs past the window, anything beyond would push UniqueIDCounter towards overflow
+	for (const FInventoryCommand& Command : Commands)
+	{
+		if ((Command.Type == EInventoryCommandType::SPLIT) && (Command.OtherUniqueID > 0) && !IsPredictedUniqueIDValid(Command.OtherUniqueID))
+			return false;
+	}
+
+	return true;
+}
+
+// Execute a batch of client commands in sequence order
+void UInventoryComponent::ServerExecuteCommands_Implementation(const TArray<FInventoryCommand>& Commands)
+{
+	for (const FInventoryCommand& Command : Commands)
+	{
+		// Ignore anything already processed
+		if (Command.Sequence <= LastProcessedSequence)
+			continue;
+
+		// Rejected commands are still acknowledged, the client picks up the authoritative state
+		ExecuteCommand(Command, false);
+		LastProcessedSequence = Command.Sequence;
+	}
+
+	MarkInventoryDirty();
+}
+
+// Authoritative state arrived, rewind to it and replay unacknowledged commands
+void UInventoryComponent::OnRep_ServerState()
+{
+	// Only slot listeners need the old state
+	TArray<FInventoryStruct> OldItemArray;
+	if (OnSlotChanged.IsBound() || OnSlotRemoved.IsBound())
+	{
+		OldItemArray = ItemArray;
+	}
+
+	// Copy into the existing allocation
+	ItemArray.Reset();
+	ItemArray.Append(ServerItemArray);
+
+	// Never predict an ID the server already handed out
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		UniqueIDCounter = FMath::Max(UniqueIDCounter, Stack.UniqueID);
+	}
+
+	if (bUseGrid)
+	{
+		RebuildGrid();
+	}
+
+	// Listeners see the step to the server state, the replayed commands publish their own changes
+	PublishSlotDifferences(OldItemArray);
+	bSnapshotDirty = true;
+	SyncAggregates();
+
+	if (StateTracker.IsActive())
+	{
+		StateTracker.Sync(ItemArray);
+	}
+
+	PendingCommands.RemoveAll([this](const FInventoryCommand& Command) {
+		return Command.Sequence <= LastProcessedSequence;
+	});
+
+	for (const FInventoryCommand& Command : PendingCommands)
+	{
+		ExecuteCommand(Command, true);
+	}
+}
+
+// Publish every slot that differs from an older copy of the array
+void UInventoryComponent::PublishSlotDifferences(const TArray<FInventoryStruct>& OldItemArray)
+{
+	if (!OnSlotChanged.IsBound() && !OnSlotRemoved.IsBound())
+		return;
+
+	TMap<int32, const FInventoryStruct*> OldStacks;
+	OldStacks.Reserve(OldItemArray.Num());
+	for (const FInventoryStruct& Stack : OldItemArray)
+	{
+		OldStacks.Add(Stack.UniqueID, &Stack);
+	}
+
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		const FInventoryStruct* OldStack = nullptr;
+		OldStacks.RemoveAndCopyValue(Stack.UniqueID, OldStack);
+
+		if (!OldStack || (OldStack->ItemClass != Stack.ItemClass) || (OldStack->ItemAmount != Stack.ItemAmount)
+			|| (OldStack->GridX != Stack.GridX) || (OldStack->GridY != Stack.GridY))
+		{
+			OnSlotChanged.Broadcast(Stack);
+		}
+	}
+
+	for (const TPair<int32, const FInventoryStruct*>& OldStack : OldStacks)
+	{
+		OnSlotRemoved.Broadcast(OldStack.Key);
+	}
+}
+
+// Tell slot listeners that all slots were replaced
+void UInventoryComponent::NotifySlotsReset()
+{
+	if (StateTracker.IsActive())
+	{
+		StateTracker.Sync(ItemArray);
+	}
+
+	SyncAggregates();
+
+	OnSlotsReset.Broadcast();
+}
+
+// Publish a new stack order to the state tracker, the journal and slot listeners
+void UInventoryComponent::NotifyOrderChanged()
+{
+	if (StateTracker.IsActive())
+	{
+		StateTracker.SetOrder(ItemArray);
+	}
+
+	// Stack records carry no order
+	JournalOrder();
+
+	OnSlotsReordered.Broadcast();
+}
+
+// Flag the inventory for publishing to the owning client
+void UInventoryComponent::MarkInventoryDirty()
+{
+	bInventoryDirty = true;
+	bSnapshotDirty = true;
+}
+
+// Rebuild ItemArray from the latest snapshot and journal tail
+bool UInventoryComponent::RecoverFromJournal()
+{
+	if (JournalName.IsEmpty())
+		return false;
+
+	TArray<FInventoryJournalSnapshotEntry> RecoveredStacks;
+	if (!FInventoryJournalWriter::Recover(JournalName, RecoveredStacks))
+		return false;
+
+	ItemArray.Reset();
+	ReserveStacks(RecoveredStacks.Num());
+
+	for (const FInventoryJournalSnapshotEntry& Entry : RecoveredStacks)
+	{
+		UClass* ItemClass = StaticLoadClass(AItem::StaticClass(), nullptr, *Entry.ClassPath);
+		if (!ItemClass || (Entry.Amount <= 0))
+			continue;
+
+		// Everything except amount, ID and position comes from the item defaults
+		AItem* DefaultItem = ItemClass->GetDefaultObject<AItem>();
+		FInventoryStruct Stack(ItemClass, DefaultItem->ItemName, DefaultItem->ItemDescription, Entry.Amount, DefaultItem->ItemMaxAmount,
+			DefaultItem->ItemWeight, DefaultItem->ItemThumbnail, DefaultItem->WeightBonus, Entry.UniqueID, DefaultItem->SortPriority, DefaultItem->Type);
+		Stack.GridWidth = DefaultItem->ItemGridWidth;
+		Stack.GridHeight = DefaultItem->ItemGridHeight;
+		Stack.GridX = Entry.GridX;
+		Stack.GridY = Entry.GridY;
+
+		// Journals of older versions have no global IDs, those stacks get a new one
+		Stack.GlobalID = (Entry.GlobalID != 0) ? Entry.GlobalID : GenerateGlobalID();
+
+		ItemArray.Add(Stack);
+		UniqueIDCounter = FMath::Max(UniqueIDCounter, Entry.UniqueID);
+	}
+
+	if (bUseGrid)
+	{
+		RebuildGrid();
+	}
+
+	NotifySlotsReset();
+
+	MarkInventoryDirty();
+
+	return true;
+}
+
+// Write the current inventory as snapshot and restart the journal
+void UInventoryComponent::CompactJournal()
+{
+	if (JournalHandle == INDEX_NONE)
+		return;
+
+	TArray<FInventoryJournalSnapshotEntry> Entries;
+	Entries.Reserve(ItemArray.Num());
+
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		FInventoryJournalSnapshotEntry Entry;
+		Entry.UniqueID = Stack.UniqueID;
+		Entry.GlobalID = Stack.GlobalID;
+		Entry.Amount = Stack.ItemAmount;
+		Entry.GridX = Stack.GridX;
+		Entry.GridY = Stack.GridY;
+		Entry.ClassPath = Stack.ItemClass ? Stack.ItemClass->GetPathName() : FString();
+		Entries.Add(MoveTemp(Entry));
+	}
+
+	FInventoryJournalWriter::Get().WriteSnapshot(JournalHandle, MoveTemp(Entries));
+
+	// The restarted journal needs its class definitions again
+	JournalClassIndices.Reset();
+	JournalRecordsSinceCompaction = 0;
+}
+
+// Publish the current state of a stack to slot listeners and the journal
+void UInventoryComponent::JournalStack(int32 StackIndex)
+{
+	PublishStack(StackIndex);
+
+	if (JournalHandle == INDEX_NONE)
+		return;
+
+	const FInventoryStruct& Stack = ItemArray[StackIndex];
+	FInventoryJournalRecord Record;
+	Record.Op = EInventoryJournalOp::SET_GLOBAL_STACK;
+	Record.UniqueID = Stack.UniqueID;
+	Record.GlobalID = Stack.GlobalID;
+	Record.ClassIndex = GetJournalClassIndex(Stack.ItemClass);
+	Record.Amount = Stack.ItemAmount;
+	Record.GridX = Stack.GridX;
+	Record.GridY = Stack.GridY;
+	FInventoryJournalWriter::Get().Append(JournalHandle, Record);
+
+	JournalRecordsSinceCompaction++;
+}
+
+// Publish the current state of a stack to slot listeners only, for changes the journal gets as one batched record
+void UInventoryComponent::PublishStack(int32 StackIndex)
+{
+	const FInventoryStruct& Stack = ItemArray[StackIndex];
+	OnSlotChanged.Broadcast(Stack);
+
+	if (StateTracker.IsActive())
+	{
+		StateTracker.SetStack(Stack);
+	}
+
+	UpdateStackAggregates(Stack);
+}
+
+// Write the order of all stacks to the journal
+void UInventoryComponent::JournalOrder()
+{
+	if (JournalHandle == INDEX_NONE)
+		return;
+
+	FInventoryJournalRecord Record;
+	Record.Op = EInventoryJournalOp::ORDER;
+	Record.UniqueIDs.Reserve(ItemArray.Num());
+
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		Record.UniqueIDs.Add(Stack.UniqueID);
+	}
+
+	FInventoryJournalWriter::Get().Append(JournalHandle, Record);
+
+	JournalRecordsSinceCompaction++;
+}
+
+// Write the grid cells of all stacks to the journal as one record
+void UInventoryComponent::JournalCells()
+{
+	if (JournalHandle == INDEX_NONE)
+		return;
+
+	FInventoryJournalRecord Record;
+	Record.Op = EInventoryJournalOp::SET_CELLS;
+	Record.UniqueIDs.Reserve(ItemArray.Num());
+	Record.Cells.Reserve(ItemArray.Num());
+
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		Record.UniqueIDs.Add(Stack.UniqueID);
+		Record.Cells.Add(FIntPoint(Stack.GridX, Stack.GridY));
+	}
+
+	FInventoryJournalWriter::Get().Append(JournalHandle, Record);
+
+	JournalRecordsSinceCompaction++;
+}
+
+// Publish the removal of a stack to slot listeners and the journal
+void UInventoryComponent::JournalRemoval(int32 UniqueID)
+{
+	OnSlotRemoved.Broadcast(UniqueID);
+
+	if (StateTracker.IsActive())
+	{
+		StateTracker.RemoveStack(UniqueID);
+	}
+
+	RemoveStackAggregates(UniqueID);
+
+	if (JournalHandle == INDEX_NONE)
+		return;
+
+	FInventoryJournalRecord Record;
+	Record.Op = EInventoryJournalOp::REMOVE_STACK;
+	Record.UniqueID = UniqueID;
+	FInventoryJournalWriter::Get().Append(JournalHandle, Record);
+
+	JournalRecordsSinceCompaction++;
+}
+
+// Index of a class in the current journal, defines it on first use
+int32 UInventoryComponent::GetJournalClassIndex(UClass* ItemClass)
+{
+	if (const int32* ClassIndex = JournalClassIndices.Find(ItemClass))
+		return *ClassIndex;
+
+	FInventoryJournalRecord Record;
+	Record.Op = EInventoryJournalOp::DEFINE_CLASS;
+	Record.ClassIndex = JournalClassIndices.Num();
+	Record.ClassPath = ItemClass ? ItemClass->GetPathName() : FString();
+	FInventoryJournalWriter::Get().Append(JournalHandle, Record);
+
+	JournalClassIndices.Add(ItemClass, Record.ClassIndex);
+
+	return Record.ClassIndex;
+}
+
+// Start writing every inventory operation to a recording file
+bool UInventoryComponent::StartRecording(const FString& Name)
+{
+	Recorder = MakeUnique<FInventoryRecorder>(FInventoryRecorder::GetRecordingPath(Name), *this);
+
+	if (!Recorder->IsOpen())
+	{
+		Recorder.Reset();
+		return false;
+	}
+
+	return true;
+}
+
+// Stop and close the current recording
+void UInventoryComponent::StopRecording()
+{
+	Recorder.Reset();
+}
+
+// Only the outermost operation is recorded, nested calls are reproduced by replaying it
+bool UInventoryComponent::IsRecordingOperation() const
+{
+	return Recorder.IsValid() && (OperationDepth == 1);
+}
+
+// Add the memory of this inventory, SeenTexts keeps texts shared between stacks from being counted twice
+void UInventoryComponent::GetMemoryUsage(FInventoryMemoryUsage& OutUsage, TSet<const void*>& SeenTexts) const
+{
+	OutUsage.ComponentBytes += GetClass()->GetStructureSize();
+	OutUsage.StackBytes += ItemArray.Num() * sizeof(FInventoryStruct);
+	OutUsage.SlackBytes += ItemArray.GetSlack() * sizeof(FInventoryStruct);
+	OutUsage.NumStacks += ItemArray.Num();
+
+	// The display string lives in the shared text data, its address identifies the payload
+	auto AddText = [&OutUsage, &SeenTexts](const FText& Text)
+	{
+		const FString& DisplayString = Text.ToString();
+		bool bAlreadySeen = false;
+		SeenTexts.Add(&DisplayString, &bAlreadySeen);
+
+		if (!bAlreadySeen)
+		{
+			OutUsage.TextBytes += DisplayString.GetAllocatedSize();
+		}
+	};
+
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		AddText(Stack.ItemName);
+		AddText(Stack.ItemDescription);
+	}
+
+	OutUsage.OtherBytes += ServerItemArray.GetAllocatedSize() + PendingCommands.GetAllocatedSize() + OutgoingCommands.GetAllocatedSize()
+		+ ProximityItems.GetAllocatedSize() + JournalClassIndices.GetAllocatedSize() + UseCooldownEndTimes.GetAllocatedSize() + Grid.GetAllocatedSize()
+		+ StateTracker.GetAllocatedSize() + UndoStates.GetAllocatedSize() + AggregatedStacks.GetAllocatedSize() + ClassTotals.GetAllocatedSize()
+		+ TagTotals.GetAllocatedSize() + PresentTagBits.Words.GetAllocatedSize() + EquippedItems.GetAllocatedSize() + EquippedVisuals.GetAllocatedSize()
+		+ EquippedMeshes.GetAllocatedSize() + FallbackVisualClasses.GetAllocatedSize();
+}
+
+// Share the current state for rollback, O(1), unchanged chunks stay shared between snapshots and the live state
+FInventoryStateSnapshot UInventoryComponent::CaptureState()
+{
+	// The first capture builds the mirror once, from then on every change keeps it current
+	if (!StateTracker.IsActive())
+	{
+		StateTracker.Reset(ItemArray);
+	}
+
+	return StateTracker.Capture();
+}
+
+// Return to a captured state, not recorded or predicted, clients get the server state again with the next update
+bool UInventoryComponent::RestoreState(const FInventoryStateSnapshot& Snapshot)
+{
+	if (!Snapshot.IsValid())
+		return false;
+
+	StateTracker.Restore(Snapshot, ItemArray);
+
+	// IDs handed out after the snapshot are never reused, the counter only moves forward
+	for (const FInventoryStruct& Stack : ItemArray)
+	{
+		UniqueIDCounter = FMath::Max(UniqueIDCounter, Stack.UniqueID);
+	}
+
+	if (bUseGrid)
+	{
+		RebuildGrid();
+	}
+
+	// A restore is no single record, the journal starts again from the restored state
+	if (JournalHandle != INDEX_NONE)
+	{
+		CompactJournal();
+	}
+
+	NotifySlotsReset();
+
+	MarkInventoryDirty();
+
+	return true;
+}
+
+// Remember the current state for UndoLastAction
+void UInventoryComponent::SaveUndoState()
+{
+	if (UndoStates.Num() >= MaxUndoStates)
+	{
+		UndoStates.RemoveAt(0, UndoStates.Num() - MaxUndoStates + 1, false);
+	}
+
+	UndoStates.Add(CaptureState());
+}
+
+// Return to the last saved state, false if there is none
+bool UInventoryComponent::UndoLastAction()
+{
+	if (UndoStates.Num() == 0)
+		return false;
+
+	return RestoreState(UndoStates.Pop(false));
+}
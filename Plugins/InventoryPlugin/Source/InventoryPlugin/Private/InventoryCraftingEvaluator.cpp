@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryCraftingEvaluator.h"
+
+// Evaluate all recipes of the book against the inventory and follow its changes
+void UInventoryCraftingEvaluator::Bind(UInventoryComponent* InInventory, UInventoryRecipeBook* InRecipeBook)
+{
+	Unbind();
+
+	Inventory = InInventory;
+	RecipeBook = InRecipeBook;
+	NumEvaluations = 0;
+
+	if (InInventory)
+	{
+		ClassTotalChangedHandle = InInventory->OnClassTotalChanged.AddUObject(this, &UInventoryCraftingEvaluator::HandleClassTotalChanged);
+	}
+
+	EvaluateAll();
+}
+
+// How often a recipe can be crafted right now
+int32 UInventoryCraftingEvaluator::GetMaxCrafts(int32 RecipeIndex) const
+{
+	return MaxCrafts.IsValidIndex(RecipeIndex) ? MaxCrafts[RecipeIndex] : 0;
+}
+
+// Indices of all recipes that can be crafted at least once
+void UInventoryCraftingEvaluator::GetCraftableRecipes(TArray<int32>& OutRecipeIndices) const
+{
+	OutRecipeIndices.Reset(NumCraftable);
+
+	for (int32 RecipeIndex = 0; RecipeIndex < MaxCrafts.Num(); RecipeIndex++)
+	{
+		if (MaxCrafts[RecipeIndex] > 0)
+		{
+			OutRecipeIndices.Add(RecipeIndex);
+		}
+	}
+}
+
+void UInventoryCraftingEvaluator::BeginDestroy()
+{
+	Unbind();
+
+	Super::BeginDestroy();
+}
+
+// Stop following the bound inventory
+void UInventoryCraftingEvaluator::Unbind()
+{
+	if (UInventoryComponent* BoundInventory = Inventory.Get())
+	{
+		BoundInventory->OnClassTotalChanged.Remove(ClassTotalChangedHandle);
+	}
+
+	Inventory.Reset();
+}
+
+void UInventoryCraftingEvaluator::HandleClassTotalChanged(UClass* ItemClass, int32 NewTotal)
+{
+	if (!RecipeBook)
+		return;
+
+	// The book was edited, every index may have changed
+	if (RecipeBook->GetVersion() != RecipeBookVersion)
+	{
+		EvaluateAll();
+		return;
+	}
+
+	for (int32 RecipeIndex : RecipeBook->GetRecipesUsing(ItemClass))
+	{
+		EvaluateRecipe(RecipeIndex);
+	}
+}
+
+// Evaluate every recipe again, after binding or when the book was edited
+void UInventoryCraftingEvaluator::EvaluateAll()
+{
+	const int32 NumRecipes = RecipeBook ? RecipeBook->Recipes.Num() : 0;
+
+	// Shorter after an edit, the dropped recipes count as not craftable anymore
+	for (int32 RecipeIndex = NumRecipes; RecipeIndex < MaxCrafts.Num(); RecipeIndex++)
+	{
+		if (MaxCrafts[RecipeIndex] > 0)
+		{
+			NumCraftable--;
+		}
+	}
+
+	MaxCrafts.SetNumZeroed(NumRecipes);
+	RecipeBookVersion = RecipeBook ? RecipeBook->GetVersion() : 0;
+
+	for (int32 RecipeIndex = 0; RecipeIndex < NumRecipes; RecipeIndex++)
+	{
+		EvaluateRecipe(RecipeIndex);
+	}
+}
+
+// Compute the max craft count of one recipe and tell listeners if it changed
+void UInventoryCraftingEvaluator::EvaluateRecipe(int32 RecipeIndex)
+{
+	NumEvaluations++;
+
+	const UInventoryComponent* BoundInventory = Inventory.Get();
+	const TArray<FInventoryRecipeIngredient>& Ingredients = RecipeBook->GetMergedIngredients(RecipeIndex);
+
+	int32 NewMaxCrafts = (BoundInventory && (Ingredients.Num() > 0)) ? MAX_int32 : 0;
+	for (int32 IngredientIndex = 0; (IngredientIndex < Ingredients.Num()) && (NewMaxCrafts > 0); IngredientIndex++)
+	{
+		const FInventoryRecipeIngredient& Ingredient = Ingredients[IngredientIndex];
+		NewMaxCrafts = FMath::Min(NewMaxCrafts, BoundInventory->GetItemCount(Ingredient.ItemClass) / Ingredient.Amount);
+	}
+
+	const int32 OldMaxCrafts = MaxCrafts[RecipeIndex];
+	if (NewMaxCrafts == OldMaxCrafts)
+		return;
+
+	MaxCrafts[RecipeIndex] = NewMaxCrafts;
+
+	if ((NewMaxCrafts > 0) && (OldMaxCrafts == 0))
+	{
+		NumCraftable++;
+	}
+	else if ((NewMaxCrafts == 0) && (OldMaxCrafts > 0))
+	{
+		NumCraftable--;
+	}
+
+	OnCraftableChanged.Broadcast(RecipeIndex, NewMaxCrafts);
+}
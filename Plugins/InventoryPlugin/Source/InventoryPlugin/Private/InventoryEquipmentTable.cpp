@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryEquipmentTable.h"
+
+// Constructor
+UInventoryEquipmentTable::UInventoryEquipmentTable(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	// The slots every character had before tables existed
+	FInventoryEquipmentSlot Backpack;
+	Backpack.SlotName = TEXT("Backpack");
+	Backpack.SocketName = TEXT("BackpackSocket");
+	Backpack.AcceptedType = EItemType::BACKPACK;
+	Backpack.bAppliesWeightBonus = true;
+	Slots.Add(Backpack);
+
+	FInventoryEquipmentSlot Weapon;
+	Weapon.SlotName = TEXT("Weapon");
+	Weapon.SocketName = TEXT("WeaponSocket");
+	Weapon.AcceptedType = EItemType::WEAPON;
+	Slots.Add(Weapon);
+
+	FInventoryEquipmentSlot Cosmetic;
+	Cosmetic.SlotName = TEXT("Cosmetic");
+	Cosmetic.SocketName = TEXT("CosmeticSocket");
+	Cosmetic.AcceptedType = EItemType::COSMETIC;
+	Slots.Add(Cosmetic);
+}
+
+// Slot id of a slot name, INDEX_NONE if there is no such slot
+int32 UInventoryEquipmentTable::FindSlot(FName SlotName) const
+{
+	if (!bIndexed)
+	{
+		BuildIndex();
+	}
+
+	const int32* SlotIndex = SlotsByName.Find(SlotName);
+	return SlotIndex ? *SlotIndex : INDEX_NONE;
+}
+
+// First slot accepting an item type, INDEX_NONE if none does
+int32 UInventoryEquipmentTable::FindSlotForType(EItemType ItemType) const
+{
+	if (!bIndexed)
+	{
+		BuildIndex();
+	}
+
+	return SlotsByType.IsValidIndex((int32)ItemType) ? SlotsByType[(int32)ItemType] : INDEX_NONE;
+}
+
+// Throw away the lookups, they are rebuilt on next use
+void UInventoryEquipmentTable::InvalidateIndex()
+{
+	bIndexed = false;
+	SlotsByName.Empty();
+	SlotsByType.Empty();
+}
+
+#if WITH_EDITOR
+void UInventoryEquipmentTable::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	InvalidateIndex();
+}
+#endif
+
+// Build the lookups by name and by type
+void UInventoryEquipmentTable::BuildIndex() const
+{
+	bIndexed = true;
+
+	for (int32 SlotIndex = 0; SlotIndex < Slots.Num(); SlotIndex++)
+	{
+		const FInventoryEquipmentSlot& Slot = Slots[SlotIndex];
+		const int32 Type = (int32)Slot.AcceptedType;
+
+		if (!SlotsByName.Contains(Slot.SlotName))
+		{
+			SlotsByName.Add(Slot.SlotName, SlotIndex);
+		}
+
+		while (SlotsByType.Num() <= Type)
+		{
+			SlotsByType.Add(INDEX_NONE);
+		}
+
+		if (SlotsByType[Type] == INDEX_NONE)
+		{
+			SlotsByType[Type] = SlotIndex;
+		}
+	}
+}
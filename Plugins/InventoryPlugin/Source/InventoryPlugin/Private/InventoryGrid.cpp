@@ -0,0 +1,180 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryGrid.h"
+
+namespace
+{
+	int32 CountBits64(uint64 Bits)
+	{
+		Bits = Bits - ((Bits >> 1) & 0x5555555555555555ull);
+		Bits = (Bits & 0x3333333333333333ull) + ((Bits >> 2) & 0x3333333333333333ull);
+		Bits = (Bits + (Bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+		return (int32)((Bits * 0x0101010101010101ull) >> 56);
+	}
+
+	int32 CountTrailingZeros64(uint64 Bits)
+	{
+		const uint32 Low = (uint32)Bits;
+		return Low ? FMath::CountTrailingZeros(Low) : 32 + FMath::CountTrailingZeros((uint32)(Bits >> 32));
+	}
+}
+
+// Constructor
+FInventoryGrid::FInventoryGrid()
+	: Columns(0), Rows(0), FullRowMask(0)
+{
+}
+
+// Resize the grid and clear all cells
+void FInventoryGrid::Init(int32 InColumns, int32 InRows)
+{
+	Columns = FMath::Clamp(InColumns, 0, MaxColumns);
+	Rows = FMath::Max(InRows, 0);
+	FullRowMask = RowMask(0, Columns);
+
+	Occupancy.Reset();
+	Occupancy.SetNumZeroed(Rows);
+}
+
+// Clear all cells
+void FInventoryGrid::Reset()
+{
+	FMemory::Memzero(Occupancy.GetData(), Occupancy.Num() * sizeof(uint64));
+}
+
+// Check if a rectangle is inside the grid and all its cells are free
+bool FInventoryGrid::Fits(int32 X, int32 Y, int32 Width, int32 Height) const
+{
+	if ((X < 0) || (Y < 0) || (Width <= 0) || (Height <= 0) || (X + Width > Columns) || (Y + Height > Rows))
+		return false;
+
+	const uint64 Mask = RowMask(X, Width);
+	for (int32 Row = Y; Row < Y + Height; Row++)
+	{
+		if (Occupancy[Row] & Mask)
+			return false;
+	}
+
+	return true;
+}
+
+// Mark the cells of a rectangle as occupied
+void FInventoryGrid::Occupy(int32 X, int32 Y, int32 Width, int32 Height)
+{
+	check((X >= 0) && (Y >= 0) && (X + Width <= Columns) && (Y + Height <= Rows));
+
+	const uint64 Mask = RowMask(X, Width);
+	for (int32 Row = Y; Row < Y + Height; Row++)
+	{
+		Occupancy[Row] |= Mask;
+	}
+}
+
+// Mark the cells of a rectangle as free
+void FInventoryGrid::Free(int32 X, int32 Y, int32 Width, int32 Height)
+{
+	check((X >= 0) && (Y >= 0) && (X + Width <= Columns) && (Y + Height <= Rows));
+
+	const uint64 Mask = RowMask(X, Width);
+	for (int32 Row = Y; Row < Y + Height; Row++)
+	{
+		Occupancy[Row] &= ~Mask;
+	}
+}
+
+// Find the first free position in reading order
+bool FInventoryGrid::FindFirstFit(int32 Width, int32 Height, int32& OutX, int32& OutY) const
+{
+	if ((Width <= 0) || (Height <= 0) || (Width > Columns))
+		return false;
+
+	for (int32 Y = 0; Y + Height <= Rows; Y++)
+	{
+		const uint64 Fits = FindFitsInRow(Y, Width, Height);
+		if (Fits)
+		{
+			OutX = CountTrailingZeros64(Fits);
+			OutY = Y;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Find the free position touching the most occupied cells and borders
+bool FInventoryGrid::FindBestFit(int32 Width, int32 Height, int32& OutX, int32& OutY) const
+{
+	if ((Width <= 0) || (Height <= 0) || (Width > Columns))
+		return false;
+
+	int32 BestScore = -1;
+
+	for (int32 Y = 0; Y + Height <= Rows; Y++)
+	{
+		uint64 Fits = FindFitsInRow(Y, Width, Height);
+		while (Fits)
+		{
+			const int32 X = CountTrailingZeros64(Fits);
+			Fits &= Fits - 1;
+
+			const int32 Score = CalculateContactScore(X, Y, Width, Height);
+			if (Score > BestScore)
+			{
+				BestScore = Score;
+				OutX = X;
+				OutY = Y;
+			}
+		}
+	}
+
+	return BestScore >= 0;
+}
+
+// Bits X to X + Width - 1 set
+uint64 FInventoryGrid::RowMask(int32 X, int32 Width) const
+{
+	const uint64 Bits = (Width >= 64) ? ~(uint64)0 : (((uint64)1 << Width) - 1);
+	return Bits << X;
+}
+
+// Bit X set for every X at which a rectangle with its top row at Y fits
+uint64 FInventoryGrid::FindFitsInRow(int32 Y, int32 Width, int32 Height) const
+{
+	uint64 Blocked = 0;
+	for (int32 Row = Y; Row < Y + Height; Row++)
+	{
+		Blocked |= Occupancy[Row];
+	}
+
+	// A start position fits if the Width columns starting there are all free
+	const uint64 FreeColumns = ~Blocked & FullRowMask;
+	uint64 Fits = FreeColumns;
+	for (int32 Shift = 1; Shift < Width && Fits; Shift++)
+	{
+		Fits &= FreeColumns >> Shift;
+	}
+
+	return Fits;
+}
+
+// Number of occupied or out of bounds cells bordering a rectangle
+int32 FInventoryGrid::CalculateContactScore(int32 X, int32 Y, int32 Width, int32 Height) const
+{
+	const uint64 Mask = RowMask(X, Width);
+	int32 Score = 0;
+
+	// Rows above and below
+	Score += (Y == 0) ? Width : CountBits64(Occupancy[Y - 1] & Mask);
+	Score += (Y + Height == Rows) ? Width : CountBits64(Occupancy[Y + Height] & Mask);
+
+	// Columns left and right
+	for (int32 Row = Y; Row < Y + Height; Row++)
+	{
+		Score += ((X == 0) || (Occupancy[Row] & ((uint64)1 << (X - 1)))) ? 1 : 0;
+		Score += ((X + Width == Columns) || (Occupancy[Row] & ((uint64)1 << (X + Width)))) ? 1 : 0;
+	}
+
+	return Score;
+}
@@ -0,0 +1,255 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryItemDatabase.h"
+#include "Item.h"
+#include "GameplayTagsModule.h"
+
+void FInventoryTagBits::SetBit(int32 Index)
+{
+	const int32 WordIndex = Index / 32;
+	if (WordIndex >= Words.Num())
+	{
+		Words.SetNumZeroed(WordIndex + 1);
+	}
+
+	Words[WordIndex] |= 1u << (Index % 32);
+}
+
+void FInventoryTagBits::ClearBit(int32 Index)
+{
+	if (Words.IsValidIndex(Index / 32))
+	{
+		Words[Index / 32] &= ~(1u << (Index % 32));
+	}
+}
+
+bool FInventoryTagBits::IsEmpty() const
+{
+	for (uint32 Word : Words)
+	{
+		if (Word != 0)
+			return false;
+	}
+
+	return true;
+}
+
+// Every bit of Other is set here
+bool FInventoryTagBits::HasAll(const FInventoryTagBits& Other) const
+{
+	for (int32 WordIndex = 0; WordIndex < Other.Words.Num(); WordIndex++)
+	{
+		const uint32 Word = Words.IsValidIndex(WordIndex) ? Words[WordIndex] : 0;
+		if ((Word & Other.Words[WordIndex]) != Other.Words[WordIndex])
+			return false;
+	}
+
+	return true;
+}
+
+// At least one bit of Other is set here
+bool FInventoryTagBits::HasAny(const FInventoryTagBits& Other) const
+{
+	const int32 NumWords = FMath::Min(Words.Num(), Other.Words.Num());
+	for (int32 WordIndex = 0; WordIndex < NumWords; WordIndex++)
+	{
+		if ((Words[WordIndex] & Other.Words[WordIndex]) != 0)
+			return true;
+	}
+
+	return false;
+}
+
+// Check an item class against a query
+bool UInventoryItemDatabase::ItemClassMatches(TSubclassOf<AItem> ItemClass, const FInventoryTagQuery& Query) const
+{
+	return CompileQuery(Query).Matches(GetClassBits(ItemClass));
+}
+
+// Bits of an item class, from the closest class with a definition, empty if there is none
+const FInventoryTagBits& UInventoryItemDatabase::GetClassBits(const UClass* ItemClass) const
+{
+	if (!bCompiled)
+	{
+		Compile();
+	}
+
+	if (const FInventoryTagBits* Bits = ClassBits.Find(ItemClass))
+		return *Bits;
+
+	static const FInventoryTagBits NoBits;
+	if (!ItemClass)
+		return NoBits;
+
+	// Remember the result for the subclass so the walk happens once per class
+	FInventoryTagBits InheritedBits = GetClassBits(ItemClass->GetSuperClass());
+	return ClassBits.Add(ItemClass, MoveTemp(InheritedBits));
+}
+
+// Bit of a tag, INDEX_NONE if no definition has the tag
+int32 UInventoryItemDatabase::GetTagBit(const FGameplayTag& Tag) const
+{
+	if (!bCompiled)
+	{
+		Compile();
+	}
+
+	const int32* Bit = TagBits.Find(Tag);
+	return Bit ? *Bit : INDEX_NONE;
+}
+
+// Amount of tag bits of the current version
+int32 UInventoryItemDatabase::GetNumTagBits() const
+{
+	if (!bCompiled)
+	{
+		Compile();
+	}
+
+	return BitTags.Num();
+}
+
+// Compact id of the definition of exactly this class, 0 if it has none
+int32 UInventoryItemDatabase::GetDefinitionId(const UClass* ItemClass) const
+{
+	if (!bCompiled)
+	{
+		Compile();
+	}
+
+	return DefinitionIds.FindRef(ItemClass);
+}
+
+// Item class of a definition id, null for 0 and unknown ids
+UClass* UInventoryItemDatabase::GetDefinitionClass(int32 DefinitionId) const
+{
+	return Definitions.IsValidIndex(DefinitionId - 1) ? *Definitions[DefinitionId - 1].ItemClass : nullptr;
+}
+
+FInventoryCompiledTagQuery UInventoryItemDatabase::CompileQuery(const FInventoryTagQuery& Query) const
+{
+	FInventoryCompiledTagQuery Compiled;
+
+	for (const FGameplayTag& Tag : Query.RequireAll)
+	{
+		const int32 Bit = GetTagBit(Tag);
+		if (Bit == INDEX_NONE)
+		{
+			Compiled.bNeverMatches = true;
+			continue;
+		}
+
+		Compiled.All.SetBit(Bit);
+	}
+
+	for (const FGameplayTag& Tag : Query.RequireAny)
+	{
+		const int32 Bit = GetTagBit(Tag);
+		if (Bit != INDEX_NONE)
+		{
+			Compiled.Any.SetBit(Bit);
+		}
+	}
+
+	// None of the wanted tags exists on any item
+	if ((Query.RequireAny.Num() > 0) && Compiled.Any.IsEmpty())
+	{
+		Compiled.bNeverMatches = true;
+	}
+
+	for (const FGameplayTag& Tag : Query.Exclude)
+	{
+		const int32 Bit = GetTagBit(Tag);
+		if (Bit != INDEX_NONE)
+		{
+			Compiled.None.SetBit(Bit);
+		}
+	}
+
+	return Compiled;
+}
+
+// Changes every time the bits are compiled again
+uint32 UInventoryItemDatabase::GetVersion() const
+{
+	if (!bCompiled)
+	{
+		Compile();
+	}
+
+	return Version;
+}
+
+// Throw away the compiled bits, they are rebuilt on the next query
+void UInventoryItemDatabase::InvalidateCompiledTags()
+{
+	bCompiled = false;
+	BitTags.Empty();
+	TagBits.Empty();
+	ClassBits.Empty();
+	DefinitionIds.Empty();
+}
+
+void UInventoryItemDatabase::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	// Renamed or removed tags change the parents of the definition tags
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		TagTreeChangedHandle = IGameplayTagsModule::OnGameplayTagTreeChanged.AddUObject(this, &UInventoryItemDatabase::InvalidateCompiledTags);
+	}
+}
+
+void UInventoryItemDatabase::BeginDestroy()
+{
+	IGameplayTagsModule::OnGameplayTagTreeChanged.Remove(TagTreeChangedHandle);
+
+	Super::BeginDestroy();
+}
+
+#if WITH_EDITOR
+void UInventoryItemDatabase::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	InvalidateCompiledTags();
+}
+#endif
+
+// Assign bits to all tags and their parents, build the class bits and the definition ids
+void UInventoryItemDatabase::Compile() const
+{
+	bCompiled = true;
+	Version++;
+
+	for (int32 DefinitionIndex = 0; DefinitionIndex < Definitions.Num(); DefinitionIndex++)
+	{
+		const FInventoryItemDefinition& Definition = Definitions[DefinitionIndex];
+		if (!*Definition.ItemClass)
+			continue;
+
+		// A class listed twice keeps its first id
+		if (!DefinitionIds.Contains(*Definition.ItemClass))
+		{
+			DefinitionIds.Add(*Definition.ItemClass, DefinitionIndex + 1);
+		}
+
+		FInventoryTagBits& Bits = ClassBits.FindOrAdd(*Definition.ItemClass);
+
+		for (const FGameplayTag& Tag : Definition.Tags)
+		{
+			// A query for a parent tag matches items with a child tag
+			for (const FGameplayTag& TagOrParent : Tag.GetGameplayTagParents())
+			{
+				int32* Bit = TagBits.Find(TagOrParent);
+				if (!Bit)
+				{
+					Bit = &TagBits.Add(TagOrParent, BitTags.Add(TagOrParent));
+				}
+
+				Bits.SetBit(*Bit);
+			}
+		}
+	}
+}
@@ -0,0 +1,465 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryJournal.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/Crc.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+namespace
+{
+	const uint32 SnapshotMagic = 0x494E5653;
+	const int32 SnapshotVersion = 2;
+
+	// Length and crc around every record payload
+	const int64 RecordFrameSize = 2 * sizeof(uint32);
+}
+
+FInventoryJournalWriter* FInventoryJournalWriter::Instance = nullptr;
+
+FArchive& operator<<(FArchive& Ar, FInventoryJournalRecord& Record)
+{
+	uint8 Op = (uint8)Record.Op;
+	Ar << Op;
+	Record.Op = (EInventoryJournalOp)Op;
+
+	switch (Record.Op)
+	{
+	case EInventoryJournalOp::DEFINE_CLASS :
+		Ar << Record.ClassIndex << Record.ClassPath;
+		break;
+
+	case EInventoryJournalOp::SET_STACK :
+		Ar << Record.UniqueID << Record.ClassIndex << Record.Amount << Record.GridX << Record.GridY;
+		break;
+
+	case EInventoryJournalOp::REMOVE_STACK :
+		Ar << Record.UniqueID;
+		break;
+
+	case EInventoryJournalOp::SET_GLOBAL_STACK :
+		Ar << Record.UniqueID << Record.GlobalID << Record.ClassIndex << Record.Amount << Record.GridX << Record.GridY;
+		break;
+
+	case EInventoryJournalOp::ORDER :
+		Ar << Record.UniqueIDs;
+		break;
+
+	case EInventoryJournalOp::SET_CELLS :
+		Ar << Record.UniqueIDs << Record.Cells;
+		if (Record.Cells.Num() != Record.UniqueIDs.Num())
+		{
+			Ar.SetError();
+		}
+		break;
+
+	default:
+		Ar.SetError();
+		break;
+	}
+
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FInventoryJournalSnapshotEntry& Entry)
+{
+	Ar << Entry.UniqueID << Entry.Amount << Entry.GridX << Entry.GridY << Entry.ClassPath;
+
+	return Ar;
+}
+
+// Constructor, starts the writer thread
+FInventoryJournalWriter::FInventoryJournalWriter()
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("InventoryJournalWriter"), 0, TPri_BelowNormal);
+}
+
+// Stop the thread, everything queued so far is written before it exits
+FInventoryJournalWriter::~FInventoryJournalWriter()
+{
+	Stop();
+
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+FInventoryJournalWriter& FInventoryJournalWriter::Get()
+{
+	check(IsInGameThread());
+
+	if (!Instance)
+	{
+		Instance = new FInventoryJournalWriter();
+	}
+
+	return *Instance;
+}
+
+void FInventoryJournalWriter::Shutdown()
+{
+	delete Instance;
+	Instance = nullptr;
+}
+
+// Open a journal for appending and return its handle
+int32 FInventoryJournalWriter::OpenJournal(const FString& Name)
+{
+	const int32 JournalHandle = NextJournalHandle.Increment();
+
+	FTask Task;
+	Task.Type = ETaskType::OPEN;
+	Task.JournalHandle = JournalHandle;
+	Task.Name = Name;
+	Tasks.Enqueue(MoveTemp(Task));
+
+	return JournalHandle;
+}
+
+// Flush and close a journal
+void FInventoryJournalWriter::CloseJournal(int32 JournalHandle)
+{
+	FTask Task;
+	Task.Type = ETaskType::CLOSE;
+	Task.JournalHandle = JournalHandle;
+	Tasks.Enqueue(MoveTemp(Task));
+
+	WakeEvent->Trigger();
+}
+
+// Queue a record, the writer picks it up with the next group
+void FInventoryJournalWriter::Append(int32 JournalHandle, const FInventoryJournalRecord& Record)
+{
+	FTask Task;
+	Task.Type = ETaskType::APPEND;
+	Task.JournalHandle = JournalHandle;
+	Task.Record = Record;
+	Tasks.Enqueue(MoveTemp(Task));
+}
+
+// Queue a snapshot covering all records queued before it
+void FInventoryJournalWriter::WriteSnapshot(int32 JournalHandle, TArray<FInventoryJournalSnapshotEntry>&& Entries)
+{
+	FTask Task;
+	Task.Type = ETaskType::SNAPSHOT;
+	Task.JournalHandle = JournalHandle;
+	Task.Snapshot = MoveTemp(Entries);
+	Tasks.Enqueue(MoveTemp(Task));
+
+	WakeEvent->Trigger();
+}
+
+uint32 FInventoryJournalWriter::Run()
+{
+	// Collect records for a group, then write and flush them together
+	while (!bStopping)
+	{
+		WakeEvent->Wait(GroupCommitMilliseconds);
+		ProcessTasks();
+	}
+
+	ProcessTasks();
+
+	for (auto& Pair : OpenJournals)
+	{
+		Pair.Value.Writer->Close();
+		delete Pair.Value.Writer;
+	}
+
+	OpenJournals.Empty();
+
+	return 0;
+}
+
+void FInventoryJournalWriter::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
+
+// Execute all queued tasks and flush the touched journals
+void FInventoryJournalWriter::ProcessTasks()
+{
+	TSet<int32> TouchedJournals;
+	FTask Task;
+
+	while (Tasks.Dequeue(Task))
+	{
+		if (Task.Type == ETaskType::OPEN)
+		{
+			FOpenJournal Journal;
+			Journal.Name = Task.Name;
+			Journal.Writer = IFileManager::Get().CreateFileWriter(*GetJournalPath(Task.Name), FILEWRITE_Append | FILEWRITE_AllowRead);
+
+			if (Journal.Writer)
+			{
+				OpenJournals.Add(Task.JournalHandle, Journal);
+			}
+
+			continue;
+		}
+
+		FOpenJournal* Journal = OpenJournals.Find(Task.JournalHandle);
+		if (!Journal)
+			continue;
+
+		switch (Task.Type)
+		{
+		case ETaskType::APPEND :
+			WriteRecord(*Journal, Task.Record);
+			TouchedJournals.Add(Task.JournalHandle);
+			break;
+
+		case ETaskType::SNAPSHOT :
+			WriteSnapshotFile(*Journal, Task.Snapshot);
+			TouchedJournals.Add(Task.JournalHandle);
+
+			// Restarting the journal failed, nothing more can be written to it
+			if (!Journal->Writer)
+			{
+				OpenJournals.Remove(Task.JournalHandle);
+			}
+			break;
+
+		case ETaskType::CLOSE :
+			Journal->Writer->Close();
+			delete Journal->Writer;
+			OpenJournals.Remove(Task.JournalHandle);
+			TouchedJournals.Remove(Task.JournalHandle);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	// One flush per journal and group
+	for (int32 JournalHandle : TouchedJournals)
+	{
+		if (FOpenJournal* Journal = OpenJournals.Find(JournalHandle))
+		{
+			Journal->Writer->Flush();
+		}
+	}
+}
+
+// Write one framed record (length, payload, crc)
+void FInventoryJournalWriter::WriteRecord(FOpenJournal& Journal, FInventoryJournalRecord& Record)
+{
+	RecordBuffer.Reset();
+	FMemoryWriter PayloadWriter(RecordBuffer);
+	PayloadWriter << Record;
+
+	uint32 Length = RecordBuffer.Num();
+	uint32 Crc = FCrc::MemCrc32(RecordBuffer.GetData(), Length);
+
+	*Journal.Writer << Length;
+	Journal.Writer->Serialize(RecordBuffer.GetData(), Length);
+	*Journal.Writer << Crc;
+}
+
+// Write a snapshot next to the journal and restart the journal
+void FInventoryJournalWriter::WriteSnapshotFile(FOpenJournal& Journal, TArray<FInventoryJournalSnapshotEntry>& Entries)
+{
+	const FString SnapshotPath = GetSnapshotPath(Journal.Name);
+	const FString TempPath = SnapshotPath + TEXT(".tmp");
+
+	FArchive* SnapshotWriter = IFileManager::Get().CreateFileWriter(*TempPath);
+	if (!SnapshotWriter)
+		return;
+
+	uint32 Magic = SnapshotMagic;
+	int32 Version = SnapshotVersion;
+	*SnapshotWriter << Magic << Version << Entries;
+
+	// Global IDs follow as their own array so version 1 entries still load with the same layout
+	TArray<int64> GlobalIDs;
+	GlobalIDs.Reserve(Entries.Num());
+	for (const FInventoryJournalSnapshotEntry& Entry : Entries)
+	{
+		GlobalIDs.Add(Entry.GlobalID);
+	}
+	*SnapshotWriter << GlobalIDs;
+	SnapshotWriter->Close();
+
+	bool bWritten = !SnapshotWriter->IsError();
+	delete SnapshotWriter;
+
+	// Keep the old snapshot and journal if the new one could not be written completely
+	if (!bWritten || !IFileManager::Get().Move(*SnapshotPath, *TempPath, true))
+		return;
+
+	// Records up to here are covered by the snapshot, replaying them again would be harmless but slow
+	Journal.Writer->Close();
+	delete Journal.Writer;
+	Journal.Writer = IFileManager::Get().CreateFileWriter(*GetJournalPath(Journal.Name), FILEWRITE_AllowRead);
+}
+
+// Load the snapshot and replay the journal tail
+bool FInventoryJournalWriter::Recover(const FString& Name, TArray<FInventoryJournalSnapshotEntry>& OutStacks)
+{
+	OutStacks.Reset();
+	bool bFoundState = false;
+
+	TArray<uint8> Data;
+	if (FFileHelper::LoadFileToArray(Data, *GetSnapshotPath(Name), FILEREAD_Silent))
+	{
+		FMemoryReader SnapshotReader(Data);
+		uint32 Magic = 0;
+		int32 Version = 0;
+		SnapshotReader << Magic << Version;
+
+		if ((Magic == SnapshotMagic) && (Version >= 1) && (Version <= SnapshotVersion))
+		{
+			SnapshotReader << OutStacks;
+
+			if (Version >= 2)
+			{
+				TArray<int64> GlobalIDs;
+				SnapshotReader << GlobalIDs;
+
+				for (int32 Index = 0; (Index < GlobalIDs.Num()) && (Index < OutStacks.Num()); Index++)
+				{
+					OutStacks[Index].GlobalID = GlobalIDs[Index];
+				}
+			}
+
+			bFoundState = !SnapshotReader.IsError();
+		}
+
+		if (!bFoundState)
+		{
+			OutStacks.Reset();
+		}
+	}
+
+	// Snapshot stacks keep their position, stacks first seen in the journal are appended like ItemArray.Add does
+	TMap<int32, FInventoryJournalSnapshotEntry> Stacks;
+	TMap<int32, int32> StackOrder;
+	int32 NextOrder = 0;
+	for (FInventoryJournalSnapshotEntry& Entry : OutStacks)
+	{
+		StackOrder.Add(Entry.UniqueID, NextOrder++);
+		Stacks.Add(Entry.UniqueID, MoveTemp(Entry));
+	}
+
+	Data.Reset();
+	if (FFileHelper::LoadFileToArray(Data, *GetJournalPath(Name), FILEREAD_Silent))
+	{
+		FMemoryReader JournalReader(Data);
+		TMap<int32, FString> ClassPaths;
+
+		while (JournalReader.Tell() + RecordFrameSize <= JournalReader.TotalSize())
+		{
+			uint32 Length = 0;
+			JournalReader << Length;
+
+			const int64 PayloadStart = JournalReader.Tell();
+			if (PayloadStart + Length + sizeof(uint32) > JournalReader.TotalSize())
+				break;
+
+			// A crash can leave a torn record at the end, everything from there on is ignored
+			uint32 Crc = 0;
+			JournalReader.Seek(PayloadStart + Length);
+			JournalReader << Crc;
+			if (Crc != FCrc::MemCrc32(Data.GetData() + PayloadStart, Length))
+				break;
+
+			FInventoryJournalRecord Record;
+			JournalReader.Seek(PayloadStart);
+			JournalReader << Record;
+			if (JournalReader.IsError() || (JournalReader.Tell() != PayloadStart + Length))
+				break;
+
+			JournalReader.Seek(PayloadStart + Length + sizeof(uint32));
+			bFoundState = true;
+
+			switch (Record.Op)
+			{
+			case EInventoryJournalOp::DEFINE_CLASS :
+				ClassPaths.Add(Record.ClassIndex, Record.ClassPath);
+				break;
+
+			case EInventoryJournalOp::SET_STACK :
+			case EInventoryJournalOp::SET_GLOBAL_STACK :
+			{
+				if (!StackOrder.Contains(Record.UniqueID))
+				{
+					StackOrder.Add(Record.UniqueID, NextOrder++);
+				}
+
+				FInventoryJournalSnapshotEntry& Entry = Stacks.FindOrAdd(Record.UniqueID);
+				Entry.UniqueID = Record.UniqueID;
+				Entry.GlobalID = (Record.Op == EInventoryJournalOp::SET_GLOBAL_STACK) ? Record.GlobalID : Entry.GlobalID;
+				Entry.Amount = Record.Amount;
+				Entry.GridX = Record.GridX;
+				Entry.GridY = Record.GridY;
+
+				if (const FString* ClassPath = ClassPaths.Find(Record.ClassIndex))
+				{
+					Entry.ClassPath = *ClassPath;
+				}
+			}
+			break;
+
+			case EInventoryJournalOp::REMOVE_STACK :
+				Stacks.Remove(Record.UniqueID);
+				StackOrder.Remove(Record.UniqueID);
+				break;
+
+			case EInventoryJournalOp::ORDER :
+				// Fresh keys after all earlier ones, listed stacks end up in the listed order
+				for (int32 UniqueID : Record.UniqueIDs)
+				{
+					if (int32* Order = StackOrder.Find(UniqueID))
+					{
+						*Order = NextOrder++;
+					}
+				}
+				break;
+
+			case EInventoryJournalOp::SET_CELLS :
+				for (int32 Index = 0; Index < Record.UniqueIDs.Num(); Index++)
+				{
+					if (FInventoryJournalSnapshotEntry* Entry = Stacks.Find(Record.UniqueIDs[Index]))
+					{
+						Entry->GridX = Record.Cells[Index].X;
+						Entry->GridY = Record.Cells[Index].Y;
+					}
+				}
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+
+	OutStacks.Reset();
+	Stacks.GenerateValueArray(OutStacks);
+	OutStacks.Sort([&StackOrder](const FInventoryJournalSnapshotEntry& One, const FInventoryJournalSnapshotEntry& Two) {
+		return StackOrder[One.UniqueID] < StackOrder[Two.UniqueID];
+	});
+
+	return bFoundState;
+}
+
+FString FInventoryJournalWriter::GetJournalPath(const FString& Name)
+{
+	return FPaths::GameSavedDir() / TEXT("InventoryJournal") / (Name + TEXT(".journal"));
+}
+
+FString FInventoryJournalWriter::GetSnapshotPath(const FString& Name)
+{
+	return FPaths::GameSavedDir() / TEXT("InventoryJournal") / (Name + TEXT(".snapshot"));
+}
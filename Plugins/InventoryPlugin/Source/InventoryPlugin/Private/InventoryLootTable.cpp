@@ -0,0 +1,214 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryLootTable.h"
+#include "InventoryPlugin.h"
+#include "Item.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+
+// Roll the table NumRolls times, drops of the same class are merged
+void UInventoryLootTable::RollLoot(const FRandomStream& Stream, int32 NumRolls, TArray<FInventoryLootDrop>& OutDrops) const
+{
+	OutDrops.Reset();
+	RollInto(Stream, NumRolls, OutDrops, 0);
+}
+
+// Throw away the alias table, it is rebuilt on the next roll
+void UInventoryLootTable::InvalidateCompiledTable()
+{
+	bCompiled = false;
+	AliasProbabilities.Empty();
+	AliasIndices.Empty();
+}
+
+#if WITH_EDITOR
+void UInventoryLootTable::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	InvalidateCompiledTable();
+}
+#endif
+
+// Build the alias table from the entry weights (Vose's method)
+void UInventoryLootTable::Compile() const
+{
+	const int32 NumEntries = Entries.Num();
+
+	AliasProbabilities.SetNumUninitialized(NumEntries);
+	AliasIndices.SetNumUninitialized(NumEntries);
+	bCompiled = true;
+
+	float TotalWeight = 0.f;
+	for (const FInventoryLootEntry& Entry : Entries)
+	{
+		TotalWeight += FMath::Max(Entry.Weight, 0.f);
+	}
+
+	// Without any weight every roll drops nothing
+	if (TotalWeight <= 0.f)
+	{
+		AliasProbabilities.Empty();
+		AliasIndices.Empty();
+		return;
+	}
+
+	// Scale so the average column is exactly full
+	TArray<float> Scaled;
+	Scaled.SetNumUninitialized(NumEntries);
+
+	TArray<int32> Small;
+	TArray<int32> Large;
+
+	for (int32 Index = 0; Index < NumEntries; Index++)
+	{
+		Scaled[Index] = FMath::Max(Entries[Index].Weight, 0.f) * NumEntries / TotalWeight;
+		AliasIndices[Index] = Index;
+
+		if (Scaled[Index] < 1.f)
+		{
+			Small.Add(Index);
+		}
+		else
+		{
+			Large.Add(Index);
+		}
+	}
+
+	// Fill every small column with the excess of a large one
+	while (Small.Num() > 0 && Large.Num() > 0)
+	{
+		const int32 SmallIndex = Small.Pop(false);
+		const int32 LargeIndex = Large.Last();
+
+		AliasProbabilities[SmallIndex] = Scaled[SmallIndex];
+		AliasIndices[SmallIndex] = LargeIndex;
+
+		Scaled[LargeIndex] -= 1.f - Scaled[SmallIndex];
+		if (Scaled[LargeIndex] < 1.f)
+		{
+			Large.Pop(false);
+			Small.Add(LargeIndex);
+		}
+	}
+
+	// Leftovers are full columns, off only by rounding
+	for (int32 Index : Small)
+	{
+		AliasProbabilities[Index] = 1.f;
+	}
+	for (int32 Index : Large)
+	{
+		AliasProbabilities[Index] = 1.f;
+	}
+}
+
+// Add the results of NumRolls rolls to OutDrops
+void UInventoryLootTable::RollInto(const FRandomStream& Stream, int32 NumRolls, TArray<FInventoryLootDrop>& OutDrops, int32 Depth) const
+{
+	if (Depth > MaxNestingDepth)
+	{
+		UE_LOG(LogInventory, Warning, TEXT("Loot table %s is nested deeper than %d tables, check for tables containing themselves"), *GetName(), MaxNestingDepth);
+		return;
+	}
+
+	if (!bCompiled)
+	{
+		Compile();
+	}
+
+	const int32 NumColumns = AliasProbabilities.Num();
+	if (NumColumns == 0)
+		return;
+
+	for (int32 Roll = 0; Roll < NumRolls; Roll++)
+	{
+		const int32 Column = Stream.RandHelper(NumColumns);
+		const int32 EntryIndex = (Stream.GetFraction() < AliasProbabilities[Column]) ? Column : AliasIndices[Column];
+		const FInventoryLootEntry& Entry = Entries[EntryIndex];
+
+		const int32 Amount = Stream.RandRange(Entry.MinAmount, FMath::Max(Entry.MinAmount, Entry.MaxAmount));
+
+		if (Entry.NestedTable)
+		{
+			Entry.NestedTable->RollInto(Stream, Amount, OutDrops, Depth + 1);
+			continue;
+		}
+
+		if (!Entry.ItemClass || Amount <= 0)
+			continue;
+
+		// Loot rarely has more than a handful of classes, a linear search beats hashing here
+		FInventoryLootDrop* Drop = OutDrops.FindByPredicate([&Entry](const FInventoryLootDrop& Existing) {
+			return Existing.ItemClass == Entry.ItemClass;
+		});
+
+		if (Drop)
+		{
+			Drop->Amount += Amount;
+		}
+		else
+		{
+			FInventoryLootDrop& NewDrop = OutDrops[OutDrops.AddDefaulted()];
+			NewDrop.ItemClass = Entry.ItemClass;
+			NewDrop.Amount = Amount;
+		}
+	}
+}
+
+// Spawn all drops in one pass spread around a point, amounts above the item max amount are split into several items
+void UInventoryLootTable::SpawnLoot(UObject* WorldContextObject, const TArray<FInventoryLootDrop>& Drops, FVector Center, float Radius, TArray<AItem*>& OutItems)
+{
+	OutItems.Reset();
+
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (!World)
+		return;
+
+	// Count the items first so the spread covers the whole radius evenly
+	int32 NumItems = 0;
+	for (const FInventoryLootDrop& Drop : Drops)
+	{
+		if (!Drop.ItemClass || Drop.Amount <= 0)
+			continue;
+
+		const int32 MaxAmount = Drop.ItemClass->GetDefaultObject<AItem>()->ItemMaxAmount;
+		NumItems += (MaxAmount > 0) ? FMath::DivideAndRoundUp(Drop.Amount, MaxAmount) : 1;
+	}
+
+	OutItems.Reserve(NumItems);
+
+	// Sunflower spiral, evenly spaced for any amount of items
+	const float GoldenAngle = PI * (3.f - FMath::Sqrt(5.f));
+	int32 ItemIndex = 0;
+
+	for (const FInventoryLootDrop& Drop : Drops)
+	{
+		if (!Drop.ItemClass || Drop.Amount <= 0)
+			continue;
+
+		const int32 MaxAmount = Drop.ItemClass->GetDefaultObject<AItem>()->ItemMaxAmount;
+		int32 RemainingAmount = Drop.Amount;
+
+		while (RemainingAmount > 0)
+		{
+			const int32 Amount = (MaxAmount > 0) ? FMath::Min(RemainingAmount, MaxAmount) : RemainingAmount;
+			RemainingAmount -= Amount;
+
+			const float Distance = Radius * FMath::Sqrt((ItemIndex + 0.5f) / NumItems);
+			const float Angle = ItemIndex * GoldenAngle;
+			const FTransform SpawnTransform(Center + FVector(FMath::Cos(Angle) * Distance, FMath::Sin(Angle) * Distance, 0.f));
+			ItemIndex++;
+
+			// Set the amount before BeginPlay
+			AItem* Item = World->SpawnActorDeferred<AItem>(Drop.ItemClass, SpawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+			if (!Item)
+				continue;
+
+			Item->PickupAmount = Amount;
+			Item->FinishSpawning(SpawnTransform);
+
+			OutItems.Add(Item);
+		}
+	}
+}
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryPlugin.h"
+#include "InventoryComponent.h"
+#include "UObject/UObjectIterator.h"
+#include "HAL/IConsoleManager.h"
+
+namespace InventoryMemoryReport
+{
+	struct FReportRow
+	{
+		int32 NumComponents = 0;
+		FInventoryMemoryUsage Usage;
+	};
+
+	static void LogRows(FOutputDevice& Ar, const TCHAR* Title, TMap<FString, FReportRow>& Rows)
+	{
+		Rows.ValueSort([](const FReportRow& One, const FReportRow& Two) {
+			return One.Usage.GetTotalBytes() > Two.Usage.GetTotalBytes();
+		});
+
+		Ar.Logf(TEXT("%-40s %8s %8s %10s %10s %10s %10s %10s %10s"), Title, TEXT("Count"), TEXT("Stacks"), TEXT("Total KB"), TEXT("Object KB"), TEXT("Stack KB"), TEXT("Slack KB"), TEXT("Text KB"), TEXT("Other KB"));
+
+		for (const TPair<FString, FReportRow>& Row : Rows)
+		{
+			const FInventoryMemoryUsage& Usage = Row.Value.Usage;
+			Ar.Logf(TEXT("%-40s %8d %8d %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f"), *Row.Key, Row.Value.NumComponents, Usage.NumStacks,
+				Usage.GetTotalBytes() / 1024.f, Usage.ComponentBytes / 1024.f, Usage.StackBytes / 1024.f, Usage.SlackBytes / 1024.f, Usage.TextBytes / 1024.f, Usage.OtherBytes / 1024.f);
+		}
+	}
+
+	// Log the memory of all live inventory components by component class and by owner class
+	static void Report(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		TMap<FString, FReportRow> ByComponentClass;
+		TMap<FString, FReportRow> ByOwnerClass;
+		FReportRow Total;
+
+		// Texts shared by several stacks or inventories are counted once in the whole report
+		TSet<const void*> SeenTexts;
+
+		for (TObjectIterator<UInventoryComponent> Iterator; Iterator; ++Iterator)
+		{
+			UInventoryComponent* Inventory = *Iterator;
+			if (Inventory->IsTemplate() || Inventory->IsPendingKill())
+				continue;
+
+			FInventoryMemoryUsage Usage;
+			Inventory->GetMemoryUsage(Usage, SeenTexts);
+
+			const AActor* Owner = Inventory->GetOwner();
+
+			FReportRow& ComponentRow = ByComponentClass.FindOrAdd(Inventory->GetClass()->GetName());
+			ComponentRow.NumComponents++;
+			ComponentRow.Usage += Usage;
+
+			FReportRow& OwnerRow = ByOwnerClass.FindOrAdd(Owner ? Owner->GetClass()->GetName() : TEXT("None"));
+			OwnerRow.NumComponents++;
+			OwnerRow.Usage += Usage;
+
+			Total.NumComponents++;
+			Total.Usage += Usage;
+		}
+
+		LogRows(Ar, TEXT("Component class"), ByComponentClass);
+		Ar.Logf(TEXT(""));
+		LogRows(Ar, TEXT("Owner class"), ByOwnerClass);
+		Ar.Logf(TEXT(""));
+		Ar.Logf(TEXT("%d inventories, %d stacks, %.1f KB total, %.1f KB slack"), Total.NumComponents, Total.Usage.NumStacks,
+			Total.Usage.GetTotalBytes() / 1024.f, Total.Usage.SlackBytes / 1024.f);
+	}
+}
+
+// Works on a headless server through the server console or -ExecCmds
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice InventoryMemReportCommand(
+	TEXT("Inventory.MemReport"),
+	TEXT("Log the memory of all inventory components by component class and owner class"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&InventoryMemoryReport::Report));
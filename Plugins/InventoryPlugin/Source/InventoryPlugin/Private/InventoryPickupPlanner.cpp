@@ -0,0 +1,215 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryPickupPlanner.h"
+
+namespace
+{
+	// One binary split part of a candidate, used by the exact solver
+	struct FPickupPart
+	{
+		int32 Candidate;
+		int32 Count;
+		int32 Weight;
+		int64 Value;
+	};
+
+	int32 GreatestCommonDivisor(int32 A, int32 B)
+	{
+		while (B != 0)
+		{
+			const int32 Temp = A % B;
+			A = B;
+			B = Temp;
+		}
+
+		return A;
+	}
+}
+
+// Plan the amounts to take of every candidate
+int64 FInventoryPickupPlanner::Plan(const TArray<FInventoryPickupCandidate>& Candidates, int32 Capacity, TArray<int32>& OutAmounts)
+{
+	OutAmounts.Reset();
+	OutAmounts.SetNumZeroed(Candidates.Num());
+
+	int64 TotalValue = 0;
+	int32 Divisor = 0;
+
+	// Weightless items are always taken completely, everything else shares the capacity
+	for (int32 Index = 0; Index < Candidates.Num(); Index++)
+	{
+		const FInventoryPickupCandidate& Candidate = Candidates[Index];
+		if (Candidate.MaxAmount <= 0)
+			continue;
+
+		if (Candidate.Weight <= 0)
+		{
+			OutAmounts[Index] = Candidate.MaxAmount;
+			TotalValue += (int64)Candidate.MaxAmount * FMath::Max(Candidate.Value, 0);
+			continue;
+		}
+
+		if (Candidate.Value > 0)
+		{
+			Divisor = GreatestCommonDivisor(Divisor, Candidate.Weight);
+		}
+	}
+
+	if ((Divisor == 0) || (Capacity <= 0))
+		return TotalValue;
+
+	// Scale weights by their common divisor to shrink the problem and clamp amounts to what could ever fit
+	const int32 ScaledCapacity = Capacity / Divisor;
+	TArray<FInventoryPickupCandidate> ScaledCandidates;
+	TArray<int32> ScaledIndices;
+	int64 NumParts = 0;
+
+	for (int32 Index = 0; Index < Candidates.Num(); Index++)
+	{
+		const FInventoryPickupCandidate& Candidate = Candidates[Index];
+		if ((Candidate.MaxAmount <= 0) || (Candidate.Weight <= 0) || (Candidate.Value <= 0))
+			continue;
+
+		const int32 ScaledWeight = Candidate.Weight / Divisor;
+		const int32 Amount = FMath::Min(Candidate.MaxAmount, ScaledCapacity / ScaledWeight);
+		if (Amount <= 0)
+			continue;
+
+		ScaledCandidates.Add(FInventoryPickupCandidate(ScaledWeight, Candidate.Value, Amount));
+		ScaledIndices.Add(Index);
+		NumParts += FMath::FloorLog2(Amount) + 1;
+	}
+
+	TArray<int32> ScaledAmounts;
+	if (NumParts * (ScaledCapacity + 1) <= MaxExactTableCells)
+	{
+		TotalValue += PlanExact(ScaledCandidates, ScaledCapacity, ScaledAmounts);
+	}
+	else
+	{
+		TotalValue += PlanGreedy(ScaledCandidates, ScaledCapacity, ScaledAmounts);
+	}
+
+	for (int32 Index = 0; Index < ScaledIndices.Num(); Index++)
+	{
+		OutAmounts[ScaledIndices[Index]] = ScaledAmounts[Index];
+	}
+
+	return TotalValue;
+}
+
+// Solve as 0/1 knapsack over power of two parts of every candidate
+int64 FInventoryPickupPlanner::PlanExact(const TArray<FInventoryPickupCandidate>& Candidates, int32 Capacity, TArray<int32>& OutAmounts)
+{
+	OutAmounts.Reset();
+	OutAmounts.SetNumZeroed(Candidates.Num());
+
+	// Split every amount into 1, 2, 4, ... and a remainder so any amount can be composed
+	TArray<FPickupPart> Parts;
+	for (int32 Index = 0; Index < Candidates.Num(); Index++)
+	{
+		const FInventoryPickupCandidate& Candidate = Candidates[Index];
+		int32 Remaining = Candidate.MaxAmount;
+
+		for (int32 Count = 1; Remaining > 0; Count <<= 1)
+		{
+			const int32 Take = FMath::Min(Count, Remaining);
+			Parts.Add({ Index, Take, Take * Candidate.Weight, (int64)Take * Candidate.Value });
+			Remaining -= Take;
+		}
+	}
+
+	const int32 Columns = Capacity + 1;
+	TArray<int64> Best;
+	Best.SetNumZeroed(Columns);
+	TBitArray<> Taken(false, Parts.Num() * Columns);
+
+	for (int32 PartIndex = 0; PartIndex < Parts.Num(); PartIndex++)
+	{
+		const FPickupPart& Part = Parts[PartIndex];
+
+		for (int32 Weight = Capacity; Weight >= Part.Weight; Weight--)
+		{
+			const int64 WithPart = Best[Weight - Part.Weight] + Part.Value;
+			if (WithPart > Best[Weight])
+			{
+				Best[Weight] = WithPart;
+				Taken[PartIndex * Columns + Weight] = true;
+			}
+		}
+	}
+
+	// Walk back through the table to recover the chosen parts
+	int32 Weight = Capacity;
+	for (int32 PartIndex = Parts.Num() - 1; PartIndex >= 0; PartIndex--)
+	{
+		if (Taken[PartIndex * Columns + Weight])
+		{
+			OutAmounts[Parts[PartIndex].Candidate] += Parts[PartIndex].Count;
+			Weight -= Parts[PartIndex].Weight;
+		}
+	}
+
+	return Best[Capacity];
+}
+
+// Take the best value per weight first, then trade cheap units for candidates that did not fit
+int64 FInventoryPickupPlanner::PlanGreedy(const TArray<FInventoryPickupCandidate>& Candidates, int32 Capacity, TArray<int32>& OutAmounts)
+{
+	OutAmounts.Reset();
+	OutAmounts.SetNumZeroed(Candidates.Num());
+
+	TArray<int32> Order;
+	Order.Reserve(Candidates.Num());
+	for (int32 Index = 0; Index < Candidates.Num(); Index++)
+	{
+		Order.Add(Index);
+	}
+
+	Order.Sort([&Candidates](int32 One, int32 Two) {
+		return (int64)Candidates[One].Value * Candidates[Two].Weight > (int64)Candidates[Two].Value * Candidates[One].Weight;
+	});
+
+	int32 Remaining = Capacity;
+	int64 TotalValue = 0;
+
+	for (int32 Index : Order)
+	{
+		const FInventoryPickupCandidate& Candidate = Candidates[Index];
+		const int32 Take = FMath::Min(Candidate.MaxAmount, Remaining / Candidate.Weight);
+
+		OutAmounts[Index] = Take;
+		Remaining -= Take * Candidate.Weight;
+		TotalValue += (int64)Take * Candidate.Value;
+	}
+
+	// Repair: make room for one more unit of a candidate by dropping units of a lower density one if that gains value
+	for (int32 Position = 0; Position < Order.Num(); Position++)
+	{
+		const int32 InIndex = Order[Position];
+		const FInventoryPickupCandidate& InCandidate = Candidates[InIndex];
+		if (OutAmounts[InIndex] >= InCandidate.MaxAmount)
+			continue;
+
+		for (int32 OutPosition = Order.Num() - 1; OutPosition > Position; OutPosition--)
+		{
+			const int32 OutIndex = Order[OutPosition];
+			const FInventoryPickupCandidate& OutCandidate = Candidates[OutIndex];
+			if (OutAmounts[OutIndex] <= 0)
+				continue;
+
+			const int32 Missing = FMath::Max(InCandidate.Weight - Remaining, 0);
+			const int32 Drop = FMath::DivideAndRoundUp(Missing, OutCandidate.Weight);
+			if ((Drop > OutAmounts[OutIndex]) || ((int64)Drop * OutCandidate.Value >= InCandidate.Value))
+				continue;
+
+			OutAmounts[OutIndex] -= Drop;
+			OutAmounts[InIndex] += 1;
+			Remaining += Drop * OutCandidate.Weight - InCandidate.Weight;
+			TotalValue += InCandidate.Value - (int64)Drop * OutCandidate.Value;
+			break;
+		}
+	}
+
+	return TotalValue;
+}
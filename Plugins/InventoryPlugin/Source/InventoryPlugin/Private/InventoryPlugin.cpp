@@ -1,9 +1,12 @@
 // Copyright 1998-2016 Epic Games, Inc. All Rights Reserved.
 
 #include "InventoryPlugin.h"
+#include "InventoryJournal.h"
 
 #define LOCTEXT_NAMESPACE "FInventoryPluginModule"
 
+DEFINE_LOG_CATEGORY(LogInventory);
+
 void FInventoryPluginModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
@@ -14,7 +17,7 @@ void FInventoryPluginModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
-	
+	FInventoryJournalWriter::Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryRecipeBook.h"
+#include "Item.h"
+
+// Indices of the recipes using a class as ingredient
+const TArray<int32>& UInventoryRecipeBook::GetRecipesUsing(const UClass* ItemClass) const
+{
+	if (!bIndexed)
+	{
+		BuildIndex();
+	}
+
+	static const TArray<int32> NoRecipes;
+	const TArray<int32>* RecipeIndices = RecipesByClass.Find(ItemClass);
+
+	return RecipeIndices ? *RecipeIndices : NoRecipes;
+}
+
+// Ingredients of a recipe with every class once and the amounts of repeated classes added up
+const TArray<FInventoryRecipeIngredient>& UInventoryRecipeBook::GetMergedIngredients(int32 RecipeIndex) const
+{
+	if (!bIndexed)
+	{
+		BuildIndex();
+	}
+
+	return MergedIngredients[RecipeIndex];
+}
+
+// Changes every time the index is built again
+uint32 UInventoryRecipeBook::GetVersion() const
+{
+	if (!bIndexed)
+	{
+		BuildIndex();
+	}
+
+	return Version;
+}
+
+// Throw away the index, it is rebuilt on next use
+void UInventoryRecipeBook::InvalidateIndex()
+{
+	bIndexed = false;
+	MergedIngredients.Empty();
+	RecipesByClass.Empty();
+}
+
+#if WITH_EDITOR
+void UInventoryRecipeBook::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	InvalidateIndex();
+}
+#endif
+
+// Build the merged ingredients and the inverted index
+void UInventoryRecipeBook::BuildIndex() const
+{
+	bIndexed = true;
+	Version++;
+
+	MergedIngredients.SetNum(Recipes.Num());
+
+	for (int32 RecipeIndex = 0; RecipeIndex < Recipes.Num(); RecipeIndex++)
+	{
+		TArray<FInventoryRecipeIngredient>& Merged = MergedIngredients[RecipeIndex];
+
+		for (const FInventoryRecipeIngredient& Ingredient : Recipes[RecipeIndex].Ingredients)
+		{
+			if (!*Ingredient.ItemClass || (Ingredient.Amount <= 0))
+				continue;
+
+			FInventoryRecipeIngredient* Existing = Merged.FindByPredicate([&Ingredient](const FInventoryRecipeIngredient& Other) {
+				return Other.ItemClass == Ingredient.ItemClass;
+			});
+
+			if (Existing)
+			{
+				Existing->Amount += Ingredient.Amount;
+				continue;
+			}
+
+			Merged.Add(Ingredient);
+			RecipesByClass.FindOrAdd(*Ingredient.ItemClass).Add(RecipeIndex);
+		}
+	}
+}
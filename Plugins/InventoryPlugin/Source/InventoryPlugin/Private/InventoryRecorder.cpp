@@ -0,0 +1,650 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryRecorder.h"
+#include "InventoryComponent.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	const TCHAR* RecordingHeader = TEXT("INVENTORYREC");
+
+	// Minimal independent model of the inventory: per class totals and the weight capacity
+	struct FInventoryReferenceModel
+	{
+		TMap<UClass*, int64> Totals;
+
+		int32 Capacity = 0;
+
+		// In grid mode additions may be cut short by free cells, those are only checked against an upper bound
+		bool bExactAdds = true;
+
+		UClass* BoundedClass = nullptr;
+
+		int64 BoundedTotal = 0;
+
+		void Reset(const UInventoryComponent& Inventory)
+		{
+			Totals.Reset();
+			for (const FInventoryStruct& Stack : Inventory.ItemArray)
+			{
+				Totals.FindOrAdd(Stack.ItemClass) += Stack.ItemAmount;
+			}
+
+			Capacity = Inventory.MaxIntentoryWeight;
+			bExactAdds = !Inventory.bUseGrid;
+		}
+
+		int64 CalculateWeight() const
+		{
+			int64 Weight = 0;
+			for (const auto& Pair : Totals)
+			{
+				Weight += Pair.Value * Pair.Key->GetDefaultObject<AItem>()->ItemWeight;
+			}
+
+			return Weight;
+		}
+
+		// Expected result of adding an offered amount, mirrors the weight rule of the inventory
+		int64 CalculateAddAmount(UClass* ItemClass, int32 Offered) const
+		{
+			const int32 UnitWeight = ItemClass->GetDefaultObject<AItem>()->ItemWeight;
+			const int64 FreeWeight = Capacity - CalculateWeight();
+
+			if ((UnitWeight <= 0) || ((int64)Offered * UnitWeight <= FreeWeight))
+				return Offered;
+
+			return FMath::Max<int64>(FreeWeight / UnitWeight, 0);
+		}
+
+		void Add(UClass* ItemClass, int64 Amount)
+		{
+			int64& Total = Totals.FindOrAdd(ItemClass);
+			Total += Amount;
+
+			if (Total == 0)
+			{
+				Totals.Remove(ItemClass);
+			}
+		}
+
+		// Compare the inventory against the model and check stack invariants
+		bool Check(const UInventoryComponent& Inventory, FString& OutError)
+		{
+			TMap<UClass*, int64> ActualTotals;
+			TSet<int32> UniqueIDs;
+
+			for (const FInventoryStruct& Stack : Inventory.ItemArray)
+			{
+				// A max amount of 0 or less means the stack is unbounded
+				if ((Stack.ItemAmount <= 0) || ((Stack.ItemMaxAmount > 0) && (Stack.ItemAmount > Stack.ItemMaxAmount)))
+				{
+					OutError = FString::Printf(TEXT("Stack %d of %s holds %d of at most %d"), Stack.UniqueID, *GetNameSafe(Stack.ItemClass), Stack.ItemAmount, Stack.ItemMaxAmount);
+					return false;
+				}
+
+				bool bDuplicate = false;
+				UniqueIDs.Add(Stack.UniqueID, &bDuplicate);
+				if (bDuplicate)
+				{
+					OutError = FString::Printf(TEXT("Unique ID %d is used by more than one stack"), Stack.UniqueID);
+					return false;
+				}
+
+				ActualTotals.FindOrAdd(Stack.ItemClass) += Stack.ItemAmount;
+			}
+
+			// Bounded additions adopt the actual result once it is known to be within the bound
+			if (BoundedClass)
+			{
+				const int64 Actual = ActualTotals.FindRef(BoundedClass);
+				if (Actual > BoundedTotal)
+				{
+					OutError = FString::Printf(TEXT("%s total is %lld, expected at most %lld"), *GetNameSafe(BoundedClass), Actual, BoundedTotal);
+					return false;
+				}
+
+				Add(BoundedClass, Actual - Totals.FindRef(BoundedClass));
+				BoundedClass = nullptr;
+			}
+
+			for (const auto& Pair : ActualTotals)
+			{
+				if (Totals.FindRef(Pair.Key) != Pair.Value)
+				{
+					OutError = FString::Printf(TEXT("%s total is %lld, expected %lld"), *GetNameSafe(Pair.Key), Pair.Value, Totals.FindRef(Pair.Key));
+					return false;
+				}
+			}
+
+			for (const auto& Pair : Totals)
+			{
+				if (!ActualTotals.Contains(Pair.Key))
+				{
+					OutError = FString::Printf(TEXT("%s is missing, expected %lld"), *GetNameSafe(Pair.Key), Pair.Value);
+					return false;
+				}
+			}
+
+			return true;
+		}
+	};
+}
+
+// Open the file and write the current state of the inventory
+FInventoryRecorder::FInventoryRecorder(const FString& InPath, const UInventoryComponent& Inventory)
+	: RecordedCapacity(Inventory.MaxIntentoryWeight)
+{
+	Writer = IFileManager::Get().CreateFileWriter(*InPath, FILEWRITE_AllowRead);
+	if (!Writer)
+		return;
+
+	WriteLine(FString::Printf(TEXT("%s %d"), RecordingHeader, FormatVersion));
+	WriteLine(FString::Printf(TEXT("CAPACITY %d"), Inventory.MaxIntentoryWeight));
+	WriteLine(FString::Printf(TEXT("COUNTER %d"), Inventory.UniqueIDCounter));
+	WriteLine(FString::Printf(TEXT("GRID %d %d %d %d"), Inventory.bUseGrid ? 1 : 0, Inventory.GridColumns, Inventory.GridRows, (int32)Inventory.GridPlacement));
+
+	for (const FInventoryStruct& Stack : Inventory.ItemArray)
+	{
+		WriteLine(FString::Printf(TEXT("STACK %s %d %d %d %d"), *GetPathNameSafe(Stack.ItemClass), Stack.ItemAmount, Stack.UniqueID, Stack.GridX, Stack.GridY));
+	}
+}
+
+FInventoryRecorder::~FInventoryRecorder()
+{
+	if (Writer)
+	{
+		Writer->Close();
+		delete Writer;
+	}
+}
+
+// Append one operation line
+void FInventoryRecorder::Record(const UInventoryComponent& Inventory, const FString& Operation)
+{
+	if (!Writer)
+		return;
+
+	// Capacity changes through equipment, which is not part of the stream
+	if (Inventory.MaxIntentoryWeight != RecordedCapacity)
+	{
+		RecordedCapacity = Inventory.MaxIntentoryWeight;
+		WriteLine(FString::Printf(TEXT("CAPACITY %d"), RecordedCapacity));
+	}
+
+	WriteLine(Operation);
+}
+
+FString FInventoryRecorder::GetRecordingPath(const FString& Name)
+{
+	return FPaths::GameSavedDir() / TEXT("InventoryRecordings") / (Name + TEXT(".invrec"));
+}
+
+void FInventoryRecorder::WriteLine(const FString& Line)
+{
+	FTCHARToUTF8 Converted(*Line);
+	Writer->Serialize((void*)Converted.Get(), Converted.Length());
+
+	ANSICHAR LineEnd = '\n';
+	Writer->Serialize(&LineEnd, 1);
+}
+
+// Parse a recording and resolve all item classes
+bool FInventoryReplay::Load(const FString& Path, FString& OutError)
+{
+	InitialStacks.Reset();
+	Operations.Reset();
+	Transfers.Reset();
+
+	FString Contents;
+	if (!FFileHelper::LoadFileToString(Contents, *Path))
+	{
+		OutError = FString::Printf(TEXT("Could not read %s"), *Path);
+		return false;
+	}
+
+	TArray<FString> Lines;
+	Contents.ParseIntoArrayLines(Lines, false);
+
+	TMap<FString, UClass*> Classes;
+	auto ResolveClass = [&Classes](const FString& ClassPath) -> UClass*
+	{
+		if (UClass** Found = Classes.Find(ClassPath))
+			return *Found;
+
+		UClass* ItemClass = StaticLoadClass(AItem::StaticClass(), nullptr, *ClassPath);
+		Classes.Add(ClassPath, ItemClass);
+
+		return ItemClass;
+	};
+
+	bool bInOperations = false;
+
+	for (int32 LineIndex = 0; LineIndex < Lines.Num(); LineIndex++)
+	{
+		TArray<FString> Tokens;
+		Lines[LineIndex].ParseIntoArrayWS(Tokens);
+		if (Tokens.Num() == 0)
+			continue;
+
+		const FString& Keyword = Tokens[0];
+		auto Arg = [&Tokens](int32 Index) { return Tokens.IsValidIndex(Index) ? FCString::Atoi(*Tokens[Index]) : 0; };
+
+		if (LineIndex == 0)
+		{
+			if ((Keyword != RecordingHeader) || (Arg(1) != FInventoryRecorder::FormatVersion))
+			{
+				OutError = FString::Printf(TEXT("%s is not a version %d inventory recording"), *Path, FInventoryRecorder::FormatVersion);
+				return false;
+			}
+
+			continue;
+		}
+
+		FOperation Operation;
+		Operation.Line = LineIndex + 1;
+
+		if (Keyword == TEXT("CAPACITY"))
+		{
+			if (!bInOperations)
+			{
+				InitialCapacity = Arg(1);
+				continue;
+			}
+
+			Operation.Type = EOperation::CAPACITY;
+			Operation.A = Arg(1);
+		}
+		else if (Keyword == TEXT("COUNTER"))
+		{
+			InitialUniqueIDCounter = Arg(1);
+			continue;
+		}
+		else if (Keyword == TEXT("GRID"))
+		{
+			bInitialUseGrid = Arg(1) != 0;
+			InitialGridColumns = Arg(2);
+			InitialGridRows = Arg(3);
+			InitialGridPlacement = (uint8)Arg(4);
+			continue;
+		}
+		else if (Keyword == TEXT("STACK"))
+		{
+			FInitialStack Stack;
+			Stack.ItemClass = ResolveClass(Tokens.IsValidIndex(1) ? Tokens[1] : FString());
+			Stack.Amount = Arg(2);
+			Stack.UniqueID = Arg(3);
+			Stack.GridX = Arg(4);
+			Stack.GridY = Arg(5);
+
+			if (!Stack.ItemClass)
+			{
+				OutError = FString::Printf(TEXT("Line %d: unknown item class"), Operation.Line);
+				return false;
+			}
+
+			InitialStacks.Add(Stack);
+			continue;
+		}
+		else if (Keyword == TEXT("ADD"))
+		{
+			Operation.Type = EOperation::ADD;
+			Operation.ItemClass = ResolveClass(Tokens.IsValidIndex(1) ? Tokens[1] : FString());
+			Operation.A = Arg(2);
+
+			if (!Operation.ItemClass)
+			{
+				OutError = FString::Printf(TEXT("Line %d: unknown item class"), Operation.Line);
+				return false;
+			}
+		}
+		else if (Keyword == TEXT("SPLIT"))
+		{
+			Operation.Type = EOperation::SPLIT;
+			Operation.A = Arg(1);
+			Operation.B = Arg(2);
+			Operation.C = Arg(3);
+		}
+		else if (Keyword == TEXT("COMBINE"))
+		{
+			Operation.Type = EOperation::COMBINE;
+			Operation.A = Arg(1);
+			Operation.B = Arg(2);
+		}
+		else if (Keyword == TEXT("REMOVE"))
+		{
+			Operation.Type = EOperation::REMOVE;
+			Operation.A = Arg(1);
+			Operation.B = Arg(2);
+			Operation.C = Arg(3);
+		}
+		else if (Keyword == TEXT("DROP"))
+		{
+			Operation.Type = EOperation::DROP;
+			Operation.A = Arg(1);
+		}
+		else if (Keyword == TEXT("SORT"))
+		{
+			Operation.Type = EOperation::SORT;
+			Operation.A = Arg(1);
+		}
+		else if (Keyword == TEXT("MOVE"))
+		{
+			Operation.Type = EOperation::MOVE;
+			Operation.A = Arg(1);
+			Operation.B = Arg(2);
+			Operation.C = Arg(3);
+		}
+		else if (Keyword == TEXT("REORDER"))
+		{
+			Operation.Type = EOperation::REORDER;
+			Operation.A = Arg(1);
+			Operation.B = Arg(2);
+		}
+		else if (Keyword == TEXT("ARRANGE"))
+		{
+			Operation.Type = EOperation::ARRANGE;
+		}
+		else if (Keyword == TEXT("CONSUME"))
+		{
+			Operation.Type = EOperation::CONSUME;
+			Operation.ItemClass = ResolveClass(Tokens.IsValidIndex(1) ? Tokens[1] : FString());
+			Operation.A = Arg(2);
+
+			if (!Operation.ItemClass)
+			{
+				OutError = FString::Printf(TEXT("Line %d: unknown item class"), Operation.Line);
+				return false;
+			}
+		}
+		else if (Keyword == TEXT("TRANSFER"))
+		{
+			const int32 NumMerges = Arg(1);
+			const int32 NumNewStacks = Arg(2);
+
+			if ((NumMerges < 0) || (NumNewStacks < 0) || (Tokens.Num() != 3 + NumMerges * 2 + NumNewStacks * 5))
+			{
+				OutError = FString::Printf(TEXT("Line %d: malformed transfer"), Operation.Line);
+				return false;
+			}
+
+			Operation.Type = EOperation::TRANSFER;
+			Operation.A = Transfers.AddDefaulted();
+			FTransfer& Transfer = Transfers[Operation.A];
+
+			int32 Token = 3;
+			for (int32 MergeIndex = 0; MergeIndex < NumMerges; MergeIndex++, Token += 2)
+			{
+				Transfer.Merges.Add(FIntPoint(Arg(Token), Arg(Token + 1)));
+			}
+
+			for (int32 StackIndex = 0; StackIndex < NumNewStacks; StackIndex++, Token += 5)
+			{
+				FInitialStack Stack;
+				Stack.ItemClass = ResolveClass(Tokens[Token]);
+				Stack.Amount = Arg(Token + 1);
+				Stack.UniqueID = Arg(Token + 2);
+				Stack.GridX = Arg(Token + 3);
+				Stack.GridY = Arg(Token + 4);
+
+				if (!Stack.ItemClass)
+				{
+					OutError = FString::Printf(TEXT("Line %d: unknown item class"), Operation.Line);
+					return false;
+				}
+
+				Transfer.NewStacks.Add(Stack);
+			}
+		}
+		else
+		{
+			OutError = FString::Printf(TEXT("Line %d: unknown operation %s"), Operation.Line, *Keyword);
+			return false;
+		}
+
+		bInOperations = true;
+		Operations.Add(Operation);
+	}
+
+	return true;
+}
+
+// Reset the inventory to the state at the start of the recording
+void FInventoryReplay::ApplyInitialState(UInventoryComponent* Inventory) const
+{
+	Inventory->ItemArray.Reset(InitialStacks.Num());
+
+	for (const FInitialStack& InitialStack : InitialStacks)
+	{
+		Inventory->ItemArray.Add(MakeStack(InitialStack));
+	}
+
+	Inventory->MaxIntentoryWeight = InitialCapacity;
+	Inventory->UniqueIDCounter = InitialUniqueIDCounter;
+	Inventory->bUseGrid = bInitialUseGrid;
+	Inventory->GridColumns = InitialGridColumns;
+	Inventory->GridRows = InitialGridRows;
+	Inventory->GridPlacement = (EGridPlacement)InitialGridPlacement;
+
+	if (Inventory->bUseGrid)
+	{
+		Inventory->RebuildGrid();
+	}
+
+	Inventory->NotifySlotsReset();
+}
+
+// Execute all operations
+bool FInventoryReplay::Run(UInventoryComponent* Inventory, bool bVerify, FString& OutError) const
+{
+	FInventoryReferenceModel Model;
+	if (bVerify)
+	{
+		Model.Reset(*Inventory);
+	}
+
+	for (const FOperation& Operation : Operations)
+	{
+		// Predict the totals before the inventory executes the operation
+		if (bVerify)
+		{
+			const TArray<FInventoryStruct>& Stacks = Inventory->ItemArray;
+
+			switch (Operation.Type)
+			{
+			case EOperation::CAPACITY :
+				Model.Capacity = Operation.A;
+				break;
+
+			case EOperation::ADD :
+				if (Model.bExactAdds)
+				{
+					Model.Add(Operation.ItemClass, Model.CalculateAddAmount(Operation.ItemClass, Operation.A));
+				}
+				else
+				{
+					Model.BoundedClass = Operation.ItemClass;
+					Model.BoundedTotal = Model.Totals.FindRef(Operation.ItemClass) + Model.CalculateAddAmount(Operation.ItemClass, Operation.A);
+				}
+				break;
+
+			case EOperation::REMOVE :
+				if (Stacks.IsValidIndex(Operation.A) && (Operation.B <= Stacks[Operation.A].ItemAmount))
+				{
+					Model.Add(Stacks[Operation.A].ItemClass, -(Operation.C ? Stacks[Operation.A].ItemAmount : Operation.B));
+				}
+				break;
+
+			case EOperation::DROP :
+				for (const FInventoryStruct& Stack : Stacks)
+				{
+					if (Stack.UniqueID == Operation.A)
+					{
+						Model.Add(Stack.ItemClass, -Stack.ItemAmount);
+						break;
+					}
+				}
+				break;
+
+			case EOperation::CONSUME :
+				if (Model.Totals.FindRef(Operation.ItemClass) >= Operation.A)
+				{
+					Model.Add(Operation.ItemClass, -Operation.A);
+				}
+				break;
+
+			case EOperation::TRANSFER :
+			{
+				const FTransfer& Transfer = Transfers[Operation.A];
+				for (const FIntPoint& Merge : Transfer.Merges)
+				{
+					if (Stacks.IsValidIndex(Merge.X))
+					{
+						Model.Add(Stacks[Merge.X].ItemClass, Merge.Y);
+					}
+				}
+
+				for (const FInitialStack& NewStack : Transfer.NewStacks)
+				{
+					Model.Add(NewStack.ItemClass, NewStack.Amount);
+				}
+			}
+			break;
+
+			default:
+				break;
+			}
+		}
+
+		Execute(Inventory, Operation);
+
+		FString Error;
+		if (bVerify && !Model.Check(*Inventory, Error))
+		{
+			OutError = FString::Printf(TEXT("Line %d: %s"), Operation.Line, *Error);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Stack of a recorded class with everything else from the item defaults
+FInventoryStruct FInventoryReplay::MakeStack(const FInitialStack& InitialStack)
+{
+	AItem* DefaultItem = InitialStack.ItemClass->GetDefaultObject<AItem>();
+	FInventoryStruct Stack(InitialStack.ItemClass, DefaultItem->ItemName, DefaultItem->ItemDescription, InitialStack.Amount, DefaultItem->ItemMaxAmount,
+		DefaultItem->ItemWeight, DefaultItem->ItemThumbnail, DefaultItem->WeightBonus, InitialStack.UniqueID, DefaultItem->SortPriority, DefaultItem->Type);
+	Stack.GridWidth = DefaultItem->ItemGridWidth;
+	Stack.GridHeight = DefaultItem->ItemGridHeight;
+	Stack.GridX = InitialStack.GridX;
+	Stack.GridY = InitialStack.GridY;
+
+	return Stack;
+}
+
+// Execute one operation through the same code paths the game uses
+void FInventoryReplay::Execute(UInventoryComponent* Inventory, const FOperation& Operation) const
+{
+	TArray<FInventoryStruct>& Stacks = Inventory->ItemArray;
+
+	switch (Operation.Type)
+	{
+	case EOperation::CAPACITY :
+		Inventory->MaxIntentoryWeight = Operation.A;
+		break;
+
+	case EOperation::ADD :
+		Inventory->AddItemFromClass(Operation.ItemClass, Operation.A);
+		break;
+
+	case EOperation::SPLIT :
+		if (Stacks.IsValidIndex(Operation.A))
+		{
+			Inventory->SplitStackWithID(Operation.A, Operation.B, Operation.C);
+		}
+		break;
+
+	case EOperation::COMBINE :
+		if (Stacks.IsValidIndex(Operation.A) && Stacks.IsValidIndex(Operation.B) && (Operation.A != Operation.B))
+		{
+			Inventory->CombineStack(Operation.A, Operation.B);
+		}
+		break;
+
+	case EOperation::REMOVE :
+		if (Stacks.IsValidIndex(Operation.A))
+		{
+			Inventory->RemoveFromStack(Operation.A, Operation.B, Operation.C != 0);
+		}
+		break;
+
+	case EOperation::DROP :
+		for (int32 Index = 0; Index < Stacks.Num(); Index++)
+		{
+			if (Stacks[Index].UniqueID == Operation.A)
+			{
+				Inventory->RemoveStackAt(Index);
+				break;
+			}
+		}
+		break;
+
+	case EOperation::SORT :
+		Inventory->SortInventory((ESortMethod)Operation.A);
+		break;
+
+	case EOperation::MOVE :
+		Inventory->MoveStackInGrid(Operation.A, Operation.B, Operation.C);
+		break;
+
+	case EOperation::REORDER :
+		if (Stacks.IsValidIndex(Operation.A) && Stacks.IsValidIndex(Operation.B))
+		{
+			FInventoryStruct Stack = Stacks[Operation.A];
+			Stacks.RemoveAt(Operation.A, 1, false);
+			Stacks.Insert(Stack, Operation.B);
+		}
+		break;
+
+	case EOperation::ARRANGE :
+		Inventory->ArrangeGrid();
+		break;
+
+	case EOperation::CONSUME :
+		Inventory->ConsumeItems(Operation.ItemClass, Operation.A);
+		break;
+
+	case EOperation::TRANSFER :
+	{
+		// The source inventory is not part of the recording, the stacks arrive as they did in the game
+		const FTransfer& Transfer = Transfers[Operation.A];
+		for (const FIntPoint& Merge : Transfer.Merges)
+		{
+			if (Stacks.IsValidIndex(Merge.X))
+			{
+				Stacks[Merge.X].ItemAmount += Merge.Y;
+			}
+		}
+
+		for (const FInitialStack& NewStack : Transfer.NewStacks)
+		{
+			Stacks.Add(MakeStack(NewStack));
+			Inventory->UniqueIDCounter = FMath::Max(Inventory->UniqueIDCounter, NewStack.UniqueID);
+		}
+
+		if (Inventory->bUseGrid)
+		{
+			Inventory->RebuildGrid();
+		}
+
+		Inventory->NotifySlotsReset();
+	}
+	break;
+
+	default:
+		break;
+	}
+}
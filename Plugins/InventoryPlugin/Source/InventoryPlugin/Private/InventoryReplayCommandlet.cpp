@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryReplayCommandlet.h"
+#include "InventoryPlugin.h"
+#include "InventoryComponent.h"
+#include "InventoryRecorder.h"
+
+// Constructor
+UInventoryReplayCommandlet::UInventoryReplayCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UInventoryReplayCommandlet::Main(const FString& Params)
+{
+	FString FilePath;
+	if (!FParse::Value(*Params, TEXT("file="), FilePath))
+	{
+		UE_LOG(LogInventory, Error, TEXT("Usage: -run=InventoryReplay -file=<path> [-verify] [-iterations=<n>]"));
+		return 1;
+	}
+
+	int32 Iterations = 1;
+	FParse::Value(*Params, TEXT("iterations="), Iterations);
+	Iterations = FMath::Max(Iterations, 1);
+
+	const bool bVerify = FParse::Param(*Params, TEXT("verify"));
+
+	FInventoryReplay Replay;
+	FString Error;
+	if (!Replay.Load(FilePath, Error))
+	{
+		UE_LOG(LogInventory, Error, TEXT("%s"), *Error);
+		return 1;
+	}
+
+	// The inventory lives without owner or world, only the stack logic runs
+	UInventoryComponent* Inventory = NewObject<UInventoryComponent>();
+	Inventory->AddToRoot();
+
+	double ReplaySeconds = 0.0;
+	int32 Result = 0;
+
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		Replay.ApplyInitialState(Inventory);
+
+		const double StartTime = FPlatformTime::Seconds();
+		const bool bSucceeded = Replay.Run(Inventory, bVerify, Error);
+		ReplaySeconds += FPlatformTime::Seconds() - StartTime;
+
+		if (!bSucceeded)
+		{
+			UE_LOG(LogInventory, Error, TEXT("Replay diverged from the reference model at %s"), *Error);
+			Result = 1;
+			break;
+		}
+	}
+
+	const int64 TotalOperations = (int64)Replay.GetNumOperations() * Iterations;
+	UE_LOG(LogInventory, Display, TEXT("Replayed %lld operations in %.3f ms (%.0f operations per second)%s"), TotalOperations, ReplaySeconds * 1000.0,
+		(ReplaySeconds > 0.0) ? TotalOperations / ReplaySeconds : 0.0, bVerify ? TEXT(", verified") : TEXT(""));
+
+	Inventory->RemoveFromRoot();
+
+	return Result;
+}
@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventorySnapshot.h"
+#include "InventoryPlugin.h"
+#include "InventoryComponent.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+FInventorySnapshot::FInventorySnapshot(uint32 InVersion, const TArray<FInventoryStruct>& InStacks)
+	: Version(InVersion)
+{
+	Stacks.SetNumUninitialized(InStacks.Num());
+
+	for (int32 Index = 0; Index < InStacks.Num(); Index++)
+	{
+		const FInventoryStruct& Source = InStacks[Index];
+		FInventorySnapshotStack& Stack = Stacks[Index];
+
+		Stack.ItemClass = Source.ItemClass;
+		Stack.ItemAmount = Source.ItemAmount;
+		Stack.ItemMaxAmount = Source.ItemMaxAmount;
+		Stack.ItemWeight = Source.ItemWeight;
+		Stack.UniqueID = Source.UniqueID;
+		Stack.GlobalID = Source.GlobalID;
+		Stack.SortPriority = Source.SortPriority;
+		Stack.GridX = Source.GridX;
+		Stack.GridY = Source.GridY;
+		Stack.ItemType = (uint8)Source.ItemType;
+
+		TotalWeight += Source.ItemWeight * Source.ItemAmount;
+	}
+}
+
+// Amount of items of a class over all stacks
+int32 FInventorySnapshot::GetItemCount(const UClass* ItemClass) const
+{
+	int32 Count = 0;
+	for (const FInventorySnapshotStack& Stack : Stacks)
+	{
+		if (Stack.ItemClass == ItemClass)
+		{
+			Count += Stack.ItemAmount;
+		}
+	}
+
+	return Count;
+}
+
+FInventorySnapshotPublisher::~FInventorySnapshotPublisher()
+{
+	// Only the last reference destroys the publisher, nobody can be reading anymore
+	delete Current;
+
+	for (FHolder* Holder : Retired)
+	{
+		delete Holder;
+	}
+
+	for (FHolder* Holder : Draining)
+	{
+		delete Holder;
+	}
+}
+
+// Latest snapshot, any thread, null before the first publish
+FInventorySnapshotPtr FInventorySnapshotPublisher::Read() const
+{
+	// Announce the read before loading, the writer does not free what it could have loaded.
+	// The epoch must still be current after announcing, otherwise the writer may already be waiting for the other one
+	int32 Epoch;
+	for (;;)
+	{
+		Epoch = FPlatformAtomics::InterlockedCompareExchange(const_cast<volatile int32*>(&ReaderEpoch), 0, 0);
+		ActiveReaders[Epoch].Increment();
+
+		if (FPlatformAtomics::InterlockedCompareExchange(const_cast<volatile int32*>(&ReaderEpoch), 0, 0) == Epoch)
+			break;
+
+		ActiveReaders[Epoch].Decrement();
+	}
+
+	FHolder* Holder = (FHolder*)FPlatformAtomics::InterlockedCompareExchangePointer((void**)&Current, nullptr, nullptr);
+	FInventorySnapshotPtr Snapshot = Holder ? Holder->Snapshot : nullptr;
+
+	ActiveReaders[Epoch].Decrement();
+
+	return Snapshot;
+}
+
+// Replace the latest snapshot, game thread only
+void FInventorySnapshotPublisher::Publish(const FInventorySnapshotPtr& Snapshot)
+{
+	FHolder* NewHolder = new FHolder;
+	NewHolder->Snapshot = Snapshot;
+	PublishedVersion = Snapshot.IsValid() ? Snapshot->Version : 0;
+
+	FHolder* OldHolder = (FHolder*)FPlatformAtomics::InterlockedExchangePtr((void**)&Current, NewHolder);
+	if (OldHolder)
+	{
+		Retired.Add(OldHolder);
+	}
+
+	ReclaimRetired();
+}
+
+// Free replaced holders no reader can still see and start the grace period of the ones retired since, game thread only
+void FInventorySnapshotPublisher::ReclaimRetired()
+{
+	// Draining holders were swapped out before the last flip, a reader that loaded one is counted in the old epoch.
+	// Readers only stay in an epoch for one load, so it empties quickly however many reads follow
+	if (Draining.Num() > 0)
+	{
+		if (ActiveReaders[ReaderEpoch ^ 1].GetValue() != 0)
+			return;
+
+		for (FHolder* Holder : Draining)
+		{
+			delete Holder;
+		}
+		Draining.Reset();
+	}
+
+	if (Retired.Num() == 0)
+		return;
+
+	// Only flip once the old epoch is empty, so no reader can still be counted in the epoch new readers move to
+	Draining = MoveTemp(Retired);
+	Retired.Reset();
+	FPlatformAtomics::InterlockedExchange(&ReaderEpoch, ReaderEpoch ^ 1);
+}
+
+// Hammer Read from worker threads while publishing, for race detectors like ThreadSanitizer, returns false on an inconsistent read
+bool FInventorySnapshotPublisher::RunStressTest(int32 NumReaders, float Seconds)
+{
+	FInventorySnapshotPublisherRef Publisher = MakeShareable(new FInventorySnapshotPublisher);
+	FThreadSafeCounter StopFlag;
+	FThreadSafeCounter Failures;
+	FThreadSafeCounter64 Reads;
+
+	// Every snapshot holds (Version % 32) + 1 stacks with amount Version, so any torn read shows
+	auto MakeSnapshot = [](uint32 Version)
+	{
+		TArray<FInventoryStruct> Stacks;
+		Stacks.SetNum((Version % 32) + 1);
+		for (FInventoryStruct& Stack : Stacks)
+		{
+			Stack.ItemAmount = (int32)Version;
+			Stack.ItemWeight = 1;
+		}
+
+		return FInventorySnapshotPtr(new FInventorySnapshot(Version, Stacks));
+	};
+
+	Publisher->Publish(MakeSnapshot(1));
+
+	TArray<TFuture<void>> ReaderTasks;
+	for (int32 Reader = 0; Reader < NumReaders; Reader++)
+	{
+		ReaderTasks.Add(Async<void>(EAsyncExecution::Thread, [Publisher, &StopFlag, &Failures, &Reads]()
+		{
+			uint32 LastVersion = 0;
+
+			while (StopFlag.GetValue() == 0)
+			{
+				FInventorySnapshotPtr Snapshot = Publisher->Read();
+
+				bool bConsistent = Snapshot.IsValid() && (Snapshot->Version >= LastVersion)
+					&& (Snapshot->Stacks.Num() == (int32)(Snapshot->Version % 32) + 1)
+					&& (Snapshot->TotalWeight == Snapshot->Stacks.Num() * (int32)Snapshot->Version);
+
+				for (int32 Index = 0; bConsistent && (Index < Snapshot->Stacks.Num()); Index++)
+				{
+					bConsistent = (Snapshot->Stacks[Index].ItemAmount == (int32)Snapshot->Version);
+				}
+
+				if (!bConsistent)
+				{
+					Failures.Increment();
+				}
+
+				LastVersion = Snapshot.IsValid() ? Snapshot->Version : LastVersion;
+				Reads.Increment();
+			}
+		}));
+	}
+
+	// Publish as fast as possible on this thread
+	const double EndTime = FPlatformTime::Seconds() + Seconds;
+	uint32 Version = 1;
+	while (FPlatformTime::Seconds() < EndTime)
+	{
+		Publisher->Publish(MakeSnapshot(++Version));
+	}
+
+	StopFlag.Set(1);
+	for (TFuture<void>& Task : ReaderTasks)
+	{
+		Task.Wait();
+	}
+
+	UE_LOG(LogInventory, Display, TEXT("Snapshot stress test: %u publishes, %lld reads on %d threads, %d inconsistent reads"),
+		Version, Reads.GetValue(), NumReaders, Failures.GetValue());
+
+	return Failures.GetValue() == 0;
+}
+
+// Run with a ThreadSanitizer build on Linux to check the publisher for races
+static FAutoConsoleCommand InventorySnapshotStressCommand(
+	TEXT("Inventory.SnapshotStress"),
+	TEXT("Read inventory snapshots from <Readers> threads while publishing for <Seconds>"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 NumReaders = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 8;
+		const float Seconds = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 5.f;
+
+		FInventorySnapshotPublisher::RunStressTest(FMath::Max(NumReaders, 1), FMath::Max(Seconds, 0.1f));
+	}));
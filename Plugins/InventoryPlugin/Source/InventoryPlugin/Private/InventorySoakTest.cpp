@@ -0,0 +1,505 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventorySoakTest.h"
+#include "InventoryPlugin.h"
+#include "InventoryComponent.h"
+#include "Item.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerStart.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Paths.h"
+#include "RenderCore.h"
+
+TMap<TWeakObjectPtr<UWorld>, TWeakObjectPtr<AInventorySoakTest>> AInventorySoakTest::WorldSoakTests;
+
+// Start a run in the current world, the defaults come from the command line
+static FAutoConsoleCommandWithWorldAndArgs InventorySoakCommand(
+	TEXT("Inventory.Soak"),
+	TEXT("Run <Bots> scripted bots on <Items> world items for <Seconds> and write a CSV to Saved/Profiling"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		FInventorySoakSettings Settings = FInventorySoakSettings::FromCommandLine();
+
+		if (Args.Num() > 0)
+		{
+			Settings.NumBots = FCString::Atoi(*Args[0]);
+		}
+		if (Args.Num() > 1)
+		{
+			Settings.NumItems = FCString::Atoi(*Args[1]);
+		}
+		if (Args.Num() > 2)
+		{
+			Settings.Seconds = FCString::Atof(*Args[2]);
+		}
+
+		// Bots look like the players of the level
+		AGameModeBase* GameMode = World ? World->GetAuthGameMode() : nullptr;
+		if (!Settings.BotClass && GameMode && GameMode->DefaultPawnClass && GameMode->DefaultPawnClass->IsChildOf(ACharacter::StaticClass()))
+		{
+			Settings.BotClass = *GameMode->DefaultPawnClass;
+		}
+
+		AInventorySoakTest::Start(World, Settings);
+	}));
+
+// Read -SoakBots= -SoakItems= -SoakSeconds= -SoakRate= -SoakRadius= -SoakSeed= -SoakCsv= -SoakItemClasses=
+FInventorySoakSettings FInventorySoakSettings::FromCommandLine()
+{
+	FInventorySoakSettings Settings;
+	const TCHAR* CommandLine = FCommandLine::Get();
+
+	FParse::Value(CommandLine, TEXT("SoakBots="), Settings.NumBots);
+	FParse::Value(CommandLine, TEXT("SoakItems="), Settings.NumItems);
+	FParse::Value(CommandLine, TEXT("SoakSeconds="), Settings.Seconds);
+	FParse::Value(CommandLine, TEXT("SoakRate="), Settings.ActionsPerSecond);
+	FParse::Value(CommandLine, TEXT("SoakRadius="), Settings.Radius);
+	FParse::Value(CommandLine, TEXT("SoakSeed="), Settings.Seed);
+	FParse::Value(CommandLine, TEXT("SoakCsv="), Settings.CsvPath);
+
+	// Comma separated class paths like /Game/Blueprints/Items/Apple.Apple_C
+	FString ItemClassList;
+	if (FParse::Value(CommandLine, TEXT("SoakItemClasses="), ItemClassList, false))
+	{
+		TArray<FString> ItemClassPaths;
+		ItemClassList.ParseIntoArray(ItemClassPaths, TEXT(","));
+
+		for (const FString& ItemClassPath : ItemClassPaths)
+		{
+			UClass* ItemClass = StaticLoadClass(AItem::StaticClass(), nullptr, *ItemClassPath);
+			if (!ItemClass)
+			{
+				UE_LOG(LogInventory, Warning, TEXT("Soak item class %s not found"), *ItemClassPath);
+				continue;
+			}
+
+			Settings.ItemClasses.Add(ItemClass);
+		}
+	}
+
+	return Settings;
+}
+
+AInventorySoakTest::FSoakCounters& AInventorySoakTest::FSoakCounters::operator+=(const FSoakCounters& Other)
+{
+	Pickups += Other.Pickups;
+	Equips += Other.Equips;
+	Drops += Other.Drops;
+	Uses += Other.Uses;
+	Splits += Other.Splits;
+	Sorts += Other.Sorts;
+	Skipped += Other.Skipped;
+
+	return *this;
+}
+
+// Constructor
+AInventorySoakTest::AInventorySoakTest(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	bReplicates = false;
+}
+
+// Spawn the bots and items of a run into a world, null if a run is already going
+AInventorySoakTest* AInventorySoakTest::Start(UWorld* World, const FInventorySoakSettings& InSettings)
+{
+	if (!World)
+		return nullptr;
+
+	if (TWeakObjectPtr<AInventorySoakTest>* Running = WorldSoakTests.Find(World))
+	{
+		if (Running->IsValid())
+		{
+			UE_LOG(LogInventory, Warning, TEXT("An inventory soak is already running"));
+			return nullptr;
+		}
+	}
+
+	if (!InSettings.BotClass)
+	{
+		UE_LOG(LogInventory, Warning, TEXT("Inventory soak needs a character class for the bots"));
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnInfo.ObjectFlags |= RF_Transient;
+	AInventorySoakTest* SoakTest = World->SpawnActor<AInventorySoakTest>(SpawnInfo);
+	if (!SoakTest)
+		return nullptr;
+
+	WorldSoakTests.Add(World, SoakTest);
+
+	SoakTest->Settings = InSettings;
+	SoakTest->BeginRun();
+
+	return SoakTest->bRunning ? SoakTest : nullptr;
+}
+
+// Run the bot actions of this frame and write the row of the last frame
+void AInventorySoakTest::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (!bRunning)
+		return;
+
+	// The counters of the row belong to the actions of the frame before
+	WriteFrameRow(DeltaSeconds);
+
+	if (FPlatformTime::Seconds() - StartTime >= Settings.Seconds)
+	{
+		FinishRun();
+		Destroy();
+		return;
+	}
+
+	// Every bot acts ActionsPerSecond times a second on average, at most once per frame
+	const float ActionChance = FMath::Clamp(Settings.ActionsPerSecond * DeltaSeconds, 0.f, 1.f);
+
+	bTrackSpawns = true;
+
+	for (int32 BotIndex = 0; BotIndex < Bots.Num(); BotIndex++)
+	{
+		ACharacter* Bot = Bots[BotIndex];
+		UInventoryComponent* Inventory = Inventories[BotIndex];
+
+		if (Bot && Inventory && !Bot->IsPendingKill() && (Random.FRand() < ActionChance))
+		{
+			RunBotAction(Bot, Inventory);
+		}
+	}
+
+	bTrackSpawns = false;
+
+	ReplenishItems();
+}
+
+// Called when the game ends or the soak is destroyed
+void AInventorySoakTest::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (bRunning)
+	{
+		FinishRun();
+	}
+
+	WorldSoakTests.Remove(GetWorld());
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Spawn the bots, open the CSV and start the clock
+void AInventorySoakTest::BeginRun()
+{
+	UWorld* World = GetWorld();
+	Random.Initialize(Settings.Seed);
+
+	for (TActorIterator<APlayerStart> It(World); It; ++It)
+	{
+		Center = It->GetActorLocation();
+		break;
+	}
+
+	// Without a configured list the items of the level decide what lies around
+	if (Settings.ItemClasses.Num() == 0)
+	{
+		for (TActorIterator<AItem> It(World); It; ++It)
+		{
+			Settings.ItemClasses.AddUnique(It->GetClass());
+		}
+	}
+
+	if (Settings.ItemClasses.Num() == 0)
+	{
+		UE_LOG(LogInventory, Warning, TEXT("Inventory soak found no item classes, pass -SoakItemClasses="));
+		Destroy();
+		return;
+	}
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	for (int32 BotIndex = 0; BotIndex < Settings.NumBots; BotIndex++)
+	{
+		ACharacter* Bot = World->SpawnActor<ACharacter>(Settings.BotClass, GetRandomLocation(), FRotator::ZeroRotator, SpawnInfo);
+		if (!Bot)
+			continue;
+
+		UInventoryComponent* Inventory = Bot->FindComponentByClass<UInventoryComponent>();
+		if (!Inventory)
+		{
+			Inventory = NewObject<UInventoryComponent>(Bot, TEXT("SoakInventory"));
+			Inventory->RegisterComponent();
+		}
+
+		Bots.Add(Bot);
+		Inventories.Add(Inventory);
+	}
+
+	ActorSpawnedHandle = World->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &AInventorySoakTest::HandleActorSpawned));
+	PreGarbageCollectHandle = FCoreUObjectDelegates::PreGarbageCollect.AddUObject(this, &AInventorySoakTest::HandlePreGarbageCollect);
+	PostGarbageCollectHandle = FCoreUObjectDelegates::PostGarbageCollect.AddUObject(this, &AInventorySoakTest::HandlePostGarbageCollect);
+
+	ReplenishItems();
+
+	if (Settings.CsvPath.IsEmpty())
+	{
+		Settings.CsvPath = FPaths::GameSavedDir() / TEXT("Profiling") / FString::Printf(TEXT("InventorySoak_%s.csv"), *FDateTime::Now().ToString());
+	}
+
+	CsvWriter = IFileManager::Get().CreateFileWriter(*Settings.CsvPath, FILEWRITE_AllowRead);
+	if (!CsvWriter)
+	{
+		UE_LOG(LogInventory, Warning, TEXT("Could not open %s"), *Settings.CsvPath);
+	}
+
+	WriteLine(TEXT("Frame,Seconds,FrameMs,GameThreadMs,GCMs,Actors,WorldItems,Stacks,InventoryKB,Pickups,Equips,Drops,Uses,Splits,Sorts,Skipped"));
+
+	UE_LOG(LogInventory, Log, TEXT("Inventory soak started with %d bots, %d items and %d item classes for %.0f seconds, writing %s"),
+		Bots.Num(), Settings.NumItems, Settings.ItemClasses.Num(), Settings.Seconds, *Settings.CsvPath);
+
+	FrameTimes.Reserve(FMath::CeilToInt(Settings.Seconds * 120.f));
+	StartTime = FPlatformTime::Seconds();
+	bRunning = true;
+}
+
+// Close the CSV, log the summary and quit if wanted
+void AInventorySoakTest::FinishRun()
+{
+	bRunning = false;
+
+	if (UWorld* World = GetWorld())
+	{
+		World->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	}
+	FCoreUObjectDelegates::PreGarbageCollect.Remove(PreGarbageCollectHandle);
+	FCoreUObjectDelegates::PostGarbageCollect.Remove(PostGarbageCollectHandle);
+
+	if (CsvWriter)
+	{
+		CsvWriter->Close();
+		delete CsvWriter;
+		CsvWriter = nullptr;
+	}
+
+	TArray<float> SortedFrameTimes = FrameTimes;
+	SortedFrameTimes.Sort();
+
+	auto Percentile = [&SortedFrameTimes](float Fraction) {
+		return SortedFrameTimes.Num() > 0 ? SortedFrameTimes[FMath::Min(FMath::FloorToInt(Fraction * SortedFrameTimes.Num()), SortedFrameTimes.Num() - 1)] : 0.f;
+	};
+
+	UE_LOG(LogInventory, Log, TEXT("Inventory soak done after %d frames: frame ms p50 %.2f p99 %.2f max %.2f, GC %.1f ms total"),
+		NumFrames, Percentile(0.5f), Percentile(0.99f), Percentile(1.f), TotalGCSeconds * 1000.0);
+	UE_LOG(LogInventory, Log, TEXT("Inventory soak actions: %d pickups, %d equips, %d drops, %d uses, %d splits, %d sorts, %d skipped"),
+		TotalCounters.Pickups, TotalCounters.Equips, TotalCounters.Drops, TotalCounters.Uses, TotalCounters.Splits, TotalCounters.Sorts, TotalCounters.Skipped);
+
+	if (Settings.bExitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+// One random action of one bot
+void AInventorySoakTest::RunBotAction(ACharacter* Bot, UInventoryComponent* Inventory)
+{
+	const int32 NumStacks = Inventory->ItemArray.Num();
+	const float Roll = Random.FRand();
+
+	// Pickups outweigh drops so inventories fill up until the weight limit pushes back
+	if (Roll < 0.35f || NumStacks == 0)
+	{
+		PickupItem(Bot, Inventory);
+		return;
+	}
+
+	const int32 StackIndex = Random.RandHelper(NumStacks);
+	const FInventoryStruct Stack = Inventory->ItemArray[StackIndex];
+
+	if (Roll < 0.55f)
+	{
+		Inventory->DropItem(Stack);
+		FrameCounters.Drops++;
+	}
+	else if (Roll < 0.75f)
+	{
+		Inventory->UseItem(Stack.ItemClass);
+		FrameCounters.Uses++;
+	}
+	else if (Roll < 0.92f)
+	{
+		if (Stack.ItemAmount > 1 && Inventory->SplitStack(StackIndex, Stack.ItemAmount / 2))
+		{
+			FrameCounters.Splits++;
+		}
+		else
+		{
+			FrameCounters.Skipped++;
+		}
+	}
+	else
+	{
+		Inventory->SortInventory((ESortMethod)Random.RandHelper((int32)ESortMethod::PRIORITY + 1));
+		FrameCounters.Sorts++;
+	}
+}
+
+void AInventorySoakTest::PickupItem(ACharacter* Bot, UInventoryComponent* Inventory)
+{
+	// Picked up and destroyed items stay in the list until they are drawn
+	while (WorldItems.Num() > 0)
+	{
+		const int32 ItemIndex = Random.RandHelper(WorldItems.Num());
+		AItem* Item = WorldItems[ItemIndex].Get();
+
+		if (!Item || Item->IsPendingKill())
+		{
+			WorldItems.RemoveAtSwap(ItemIndex);
+			continue;
+		}
+
+		// Walking there is not what is measured, the bot just appears next to the item
+		Bot->SetActorLocation(Item->GetActorLocation(), false, nullptr, ETeleportType::TeleportPhysics);
+
+		const bool bEquip = Item->Type != EItemType::DEFAULT;
+		if (!Inventory->AddItem(Item))
+		{
+			FrameCounters.Skipped++;
+			return;
+		}
+
+		if (bEquip)
+		{
+			FrameCounters.Equips++;
+		}
+		else
+		{
+			FrameCounters.Pickups++;
+		}
+
+		// Partial pickups leave the rest lying there
+		if (Item->IsPendingKill())
+		{
+			WorldItems.RemoveAtSwap(ItemIndex);
+		}
+
+		return;
+	}
+
+	FrameCounters.Skipped++;
+}
+
+// Spawn items until the level holds NumItems again
+void AInventorySoakTest::ReplenishItems()
+{
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	// Items that fell out of the world or were picked up by someone else
+	WorldItems.RemoveAllSwap([](const TWeakObjectPtr<AItem>& Item) {
+		return !Item.IsValid() || Item->IsPendingKill();
+	});
+
+	while (WorldItems.Num() < Settings.NumItems)
+	{
+		TSubclassOf<AItem> ItemClass = Settings.ItemClasses[Random.RandHelper(Settings.ItemClasses.Num())];
+
+		AItem* Item = GetWorld()->SpawnActor<AItem>(ItemClass, GetRandomLocation(), FRotator::ZeroRotator, SpawnInfo);
+		if (!Item)
+			break;
+
+		WorldItems.Add(Item);
+	}
+}
+
+// Random location on the soak area
+FVector AInventorySoakTest::GetRandomLocation()
+{
+	return Center + FVector(Random.FRandRange(-Settings.Radius, Settings.Radius), Random.FRandRange(-Settings.Radius, Settings.Radius), 0.f);
+}
+
+// Append the row of the frame that just ended
+void AInventorySoakTest::WriteFrameRow(float DeltaSeconds)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	int32 NumStacks = 0;
+	for (const UInventoryComponent* Inventory : Inventories)
+	{
+		NumStacks += Inventory ? Inventory->ItemArray.Num() : 0;
+	}
+
+	if (Now >= NextMemorySampleTime)
+	{
+		NextMemorySampleTime = Now + 1.0;
+
+		FInventoryMemoryUsage Usage;
+		TSet<const void*> SeenTexts;
+		for (const UInventoryComponent* Inventory : Inventories)
+		{
+			if (Inventory)
+			{
+				Inventory->GetMemoryUsage(Usage, SeenTexts);
+			}
+		}
+
+		InventoryKilobytes = Usage.GetTotalBytes() / 1024.f;
+	}
+
+	const float FrameMs = DeltaSeconds * 1000.f;
+	FrameTimes.Add(FrameMs);
+
+	WriteLine(FString::Printf(TEXT("%d,%.3f,%.3f,%.3f,%.3f,%d,%d,%d,%.1f,%d,%d,%d,%d,%d,%d,%d"),
+		NumFrames, Now - StartTime, FrameMs, FPlatformTime::ToMilliseconds(GGameThreadTime), FrameGCSeconds * 1000.0,
+		GetWorld()->GetActorCount(), WorldItems.Num(), NumStacks, InventoryKilobytes,
+		FrameCounters.Pickups, FrameCounters.Equips, FrameCounters.Drops, FrameCounters.Uses, FrameCounters.Splits, FrameCounters.Sorts, FrameCounters.Skipped));
+
+	NumFrames++;
+	TotalCounters += FrameCounters;
+	FrameCounters = FSoakCounters();
+	FrameGCSeconds = 0.0;
+}
+
+void AInventorySoakTest::WriteLine(const FString& Line)
+{
+	if (!CsvWriter)
+		return;
+
+	FTCHARToUTF8 Converted(*Line);
+	CsvWriter->Serialize((void*)Converted.Get(), Converted.Length());
+
+	ANSICHAR LineEnd = '\n';
+	CsvWriter->Serialize(&LineEnd, 1);
+}
+
+// Items dropped by the bots become pickups for the others
+void AInventorySoakTest::HandleActorSpawned(AActor* Actor)
+{
+	if (!bTrackSpawns)
+		return;
+
+	if (AItem* Item = Cast<AItem>(Actor))
+	{
+		WorldItems.Add(Item);
+	}
+}
+
+void AInventorySoakTest::HandlePreGarbageCollect()
+{
+	GCStartTime = FPlatformTime::Seconds();
+}
+
+void AInventorySoakTest::HandlePostGarbageCollect()
+{
+	const double Seconds = FPlatformTime::Seconds() - GCStartTime;
+
+	FrameGCSeconds += Seconds;
+	TotalGCSeconds += Seconds;
+}
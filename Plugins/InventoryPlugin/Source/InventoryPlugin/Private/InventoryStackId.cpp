@@ -0,0 +1,213 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryStackId.h"
+#include "InventoryPlugin.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+namespace InventoryStackId
+{
+	const uint32 SequencesPerBlock = 1u << FInventoryStackIdGenerator::SequenceBits;
+
+	// Shared state, only touched once per block
+	struct FBlockState
+	{
+		FBlockState()
+		{
+			int32 ShardValue = 0;
+			FParse::Value(FCommandLine::Get(), TEXT("InventoryShard="), ShardValue);
+
+			// The top bit of a shard would make the IDs negative
+			if ((ShardValue < 0) || (ShardValue > FInventoryStackIdGenerator::MaxShard))
+			{
+				UE_LOG(LogInventory, Error, TEXT("Inventory shard %d is out of range 0-%d, using shard 0"), ShardValue, FInventoryStackIdGenerator::MaxShard);
+				ShardValue = 0;
+			}
+			Shard = (uint16)ShardValue;
+
+			// Everything below the saved high water mark may have been handed out before
+			FString HighWaterMark;
+			if (FFileHelper::LoadFileToString(HighWaterMark, *GetHighWaterMarkPath()))
+			{
+				NextBlock = FCString::Atoi64(*HighWaterMark);
+			}
+
+			// Block 0 is never used so no ID is 0
+			NextBlock = FMath::Max<int64>(NextBlock, 1);
+			ReservedEnd = NextBlock;
+		}
+
+		FString GetHighWaterMarkPath() const
+		{
+			return FPaths::GameSavedDir() / TEXT("Inventory") / FString::Printf(TEXT("StackIdBlocks_%d.txt"), (int32)Shard);
+		}
+
+		uint16 Shard = 0;
+
+		// Next free block, taken with one atomic increment
+		volatile int64 NextBlock = 0;
+
+		// End of the blocks already saved as used
+		volatile int64 ReservedEnd = 0;
+
+		// Only held while moving the high water mark
+		FCriticalSection ReserveLock;
+	};
+
+	static FBlockState& GetState()
+	{
+		static FBlockState State;
+		return State;
+	}
+
+	// Block and next sequence of the calling thread, a sequence of SequencesPerBlock means no block yet
+	struct FThreadBlock
+	{
+		uint32 Block = 0;
+		uint32 Sequence = SequencesPerBlock;
+	};
+
+	static thread_local FThreadBlock ThreadBlock;
+}
+
+// Next ID, any thread, lock free, never 0
+int64 FInventoryStackIdGenerator::Generate()
+{
+	using namespace InventoryStackId;
+
+	FThreadBlock& Current = ThreadBlock;
+	if (Current.Sequence >= SequencesPerBlock)
+	{
+		Current.Block = AcquireBlock();
+		Current.Sequence = 0;
+	}
+
+	const uint64 Shard = GetState().Shard;
+
+	return (int64)((Shard << (BlockBits + SequenceBits)) | ((uint64)Current.Block << SequenceBits) | Current.Sequence++);
+}
+
+// Shard prefix of this process, set with -InventoryShard=<0-32767>, 0 by default
+int32 FInventoryStackIdGenerator::GetShard()
+{
+	return InventoryStackId::GetState().Shard;
+}
+
+// Reserve a new block for the calling thread
+uint32 FInventoryStackIdGenerator::AcquireBlock()
+{
+	using namespace InventoryStackId;
+
+	FBlockState& State = GetState();
+	const int64 Block = FPlatformAtomics::InterlockedIncrement(&State.NextBlock) - 1;
+
+	// Once per BlocksPerReservation blocks the high water mark moves, the block is only used after it is saved
+	if (Block >= FPlatformAtomics::InterlockedCompareExchange(&State.ReservedEnd, 0, 0))
+	{
+		FScopeLock Lock(&State.ReserveLock);
+
+		while (Block >= State.ReservedEnd)
+		{
+			const int64 NewReservedEnd = FMath::Max<int64>(State.ReservedEnd, Block + 1) + BlocksPerReservation;
+			if (!FFileHelper::SaveStringToFile(FString::Printf(TEXT("%lld"), NewReservedEnd), *State.GetHighWaterMarkPath()))
+			{
+				UE_LOG(LogInventory, Error, TEXT("Could not save the stack ID high water mark, IDs may repeat after a restart"));
+			}
+
+			FPlatformAtomics::InterlockedExchange(&State.ReservedEnd, NewReservedEnd);
+		}
+	}
+
+	checkf(Block <= MAX_uint32, TEXT("Stack ID blocks of shard %d are used up"), (int32)State.Shard);
+
+	return (uint32)Block;
+}
+
+// Generate IDs on several threads for a while and check they are unique, logs the rate
+bool FInventoryStackIdGenerator::RunStressTest(int32 NumThreads, float Seconds)
+{
+	FThreadSafeCounter64 Generated;
+	FThreadSafeCounter Failures;
+	TArray<TArray<int64>> FirstIDs;
+	FirstIDs.SetNum(NumThreads);
+
+	const double EndTime = FPlatformTime::Seconds() + Seconds;
+
+	TArray<TFuture<void>> Tasks;
+	for (int32 Thread = 0; Thread < NumThreads; Thread++)
+	{
+		TArray<int64>& ThreadIDs = FirstIDs[Thread];
+
+		Tasks.Add(Async<void>(EAsyncExecution::Thread, [EndTime, &ThreadIDs, &Generated, &Failures]()
+		{
+			int64 Count = 0;
+			int64 LastID = 0;
+
+			while (FPlatformTime::Seconds() < EndTime)
+			{
+				// Check the clock rarely, generating is much cheaper than reading it
+				for (int32 Index = 0; Index < 4096; Index++)
+				{
+					const int64 ID = Generate();
+
+					// IDs of one thread only ever grow, within a block and from block to block
+					if (ID <= LastID)
+					{
+						Failures.Increment();
+					}
+
+					// Keep a sample for the check across threads
+					if ((Count++ & 0xFFF) == 0)
+					{
+						ThreadIDs.Add(ID);
+					}
+
+					LastID = ID;
+				}
+			}
+
+			Generated.Add(Count);
+		}));
+	}
+
+	for (TFuture<void>& Task : Tasks)
+	{
+		Task.Wait();
+	}
+
+	TSet<int64> SeenIDs;
+	for (const TArray<int64>& ThreadIDs : FirstIDs)
+	{
+		for (int64 ID : ThreadIDs)
+		{
+			bool bAlreadySeen = false;
+			SeenIDs.Add(ID, &bAlreadySeen);
+
+			if (bAlreadySeen)
+			{
+				Failures.Increment();
+			}
+		}
+	}
+
+	UE_LOG(LogInventory, Display, TEXT("Stack ID stress test: %lld IDs on %d threads, %.1f million per second, %d duplicates"),
+		Generated.GetValue(), NumThreads, Generated.GetValue() / (Seconds * 1000000.0), Failures.GetValue());
+
+	return Failures.GetValue() == 0;
+}
+
+static FAutoConsoleCommand InventoryStackIdStressCommand(
+	TEXT("Inventory.StackIdStress"),
+	TEXT("Generate stack IDs on <Threads> threads for <Seconds> and log the rate"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 NumThreads = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : FPlatformMisc::NumberOfCores();
+		const float Seconds = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 2.f;
+
+		FInventoryStackIdGenerator::RunStressTest(FMath::Max(NumThreads, 1), FMath::Max(Seconds, 0.1f));
+	}));
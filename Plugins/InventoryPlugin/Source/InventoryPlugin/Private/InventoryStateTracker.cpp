@@ -0,0 +1,257 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryStateTracker.h"
+#include "InventoryComponent.h"
+
+// One stack in a chunk
+struct FInventoryStateSlot
+{
+	FInventoryStruct Stack;
+
+	// Position in ItemArray relative to the other slots
+	int64 OrderKey = 0;
+
+	bool bUsed = false;
+};
+
+// Copy-on-write storage of inventory stacks: a shared table of shared chunks.
+// A snapshot shares the table, the first change after it copies the table of chunk pointers and the one chunk it touches.
+struct FInventoryStateChunkTable
+{
+	static const int32 ChunkSize = 32;
+
+	struct FChunk
+	{
+		FInventoryStateSlot Slots[ChunkSize];
+	};
+
+	TArray<TSharedPtr<FChunk>> Chunks;
+};
+
+namespace InventoryStateTracker
+{
+	static bool IsSameStack(const FInventoryStruct& One, const FInventoryStruct& Two)
+	{
+		return (One.ItemClass == Two.ItemClass) && (One.GlobalID == Two.GlobalID) && (One.ItemAmount == Two.ItemAmount) && (One.ItemMaxAmount == Two.ItemMaxAmount)
+			&& (One.ItemWeight == Two.ItemWeight) && (One.WeightBonus == Two.WeightBonus) && (One.SortPriority == Two.SortPriority)
+			&& (One.ItemType == Two.ItemType) && (One.ItemThumbnail == Two.ItemThumbnail)
+			&& (One.GridWidth == Two.GridWidth) && (One.GridHeight == Two.GridHeight) && (One.GridX == Two.GridX) && (One.GridY == Two.GridY)
+			&& One.ItemName.IdenticalTo(Two.ItemName) && One.ItemDescription.IdenticalTo(Two.ItemDescription);
+	}
+}
+
+// Start over from the given stacks
+void FInventoryStateTracker::Reset(const TArray<FInventoryStruct>& Stacks)
+{
+	Table = MakeShareable(new FInventoryStateChunkTable);
+	SlotIndices.Reset();
+	FreeSlots.Reset();
+	NumSlots = 0;
+	NextOrderKey = 0;
+
+	for (const FInventoryStruct& Stack : Stacks)
+	{
+		SetStack(Stack);
+	}
+}
+
+// Catch up with an array that was replaced as a whole, only chunks of changed stacks are copied
+void FInventoryStateTracker::Sync(const TArray<FInventoryStruct>& Stacks)
+{
+	TSet<int32> RemainingIDs;
+	RemainingIDs.Reserve(Stacks.Num());
+
+	for (const FInventoryStruct& Stack : Stacks)
+	{
+		RemainingIDs.Add(Stack.UniqueID);
+
+		const int32* SlotIndex = SlotIndices.Find(Stack.UniqueID);
+		if (SlotIndex && InventoryStateTracker::IsSameStack(Table->Chunks[*SlotIndex / FInventoryStateChunkTable::ChunkSize]->Slots[*SlotIndex % FInventoryStateChunkTable::ChunkSize].Stack, Stack))
+			continue;
+
+		SetStack(Stack);
+	}
+
+	TArray<int32> RemovedIDs;
+	for (const TPair<int32, int32>& SlotIndex : SlotIndices)
+	{
+		if (!RemainingIDs.Contains(SlotIndex.Key))
+		{
+			RemovedIDs.Add(SlotIndex.Key);
+		}
+	}
+
+	for (int32 UniqueID : RemovedIDs)
+	{
+		RemoveStack(UniqueID);
+	}
+
+	SetOrder(Stacks);
+}
+
+// Add or change a stack, new stacks go to the end of the order
+void FInventoryStateTracker::SetStack(const FInventoryStruct& Stack)
+{
+	if (const int32* SlotIndex = SlotIndices.Find(Stack.UniqueID))
+	{
+		GetMutableSlot(*SlotIndex).Stack = Stack;
+		return;
+	}
+
+	int32 SlotIndex;
+	if (FreeSlots.Num() > 0)
+	{
+		SlotIndex = FreeSlots.Pop(false);
+	}
+	else
+	{
+		SlotIndex = NumSlots++;
+		if (SlotIndex >= Table->Chunks.Num() * FInventoryStateChunkTable::ChunkSize)
+		{
+			// A new chunk only changes the table
+			if (!Table.IsUnique())
+			{
+				Table = MakeShareable(new FInventoryStateChunkTable(*Table));
+			}
+			Table->Chunks.Add(MakeShareable(new FInventoryStateChunkTable::FChunk));
+		}
+	}
+
+	FInventoryStateSlot& Slot = GetMutableSlot(SlotIndex);
+	Slot.Stack = Stack;
+	Slot.OrderKey = NextOrderKey++;
+	Slot.bUsed = true;
+
+	SlotIndices.Add(Stack.UniqueID, SlotIndex);
+}
+
+void FInventoryStateTracker::RemoveStack(int32 UniqueID)
+{
+	int32 SlotIndex;
+	if (!SlotIndices.RemoveAndCopyValue(UniqueID, SlotIndex))
+		return;
+
+	// Drop the texts as well so the chunk does not keep them alive
+	FInventoryStateSlot& Slot = GetMutableSlot(SlotIndex);
+	Slot.Stack = FInventoryStruct();
+	Slot.bUsed = false;
+
+	FreeSlots.Add(SlotIndex);
+}
+
+// Take the order of all stacks from the array after sorting or reordering
+void FInventoryStateTracker::SetOrder(const TArray<FInventoryStruct>& Stacks)
+{
+	// Slots already in increasing order keep their key, so only the chunks of moved stacks get copied
+	int64 PreviousKey = -1;
+
+	for (const FInventoryStruct& Stack : Stacks)
+	{
+		const int32* SlotIndex = SlotIndices.Find(Stack.UniqueID);
+		if (!SlotIndex)
+			continue;
+
+		const int64 OrderKey = Table->Chunks[*SlotIndex / FInventoryStateChunkTable::ChunkSize]->Slots[*SlotIndex % FInventoryStateChunkTable::ChunkSize].OrderKey;
+		if (OrderKey > PreviousKey)
+		{
+			PreviousKey = OrderKey;
+			continue;
+		}
+
+		PreviousKey = NextOrderKey++;
+		GetMutableSlot(*SlotIndex).OrderKey = PreviousKey;
+	}
+}
+
+// Share the current state, O(1)
+FInventoryStateSnapshot FInventoryStateTracker::Capture() const
+{
+	FInventoryStateSnapshot Snapshot;
+	Snapshot.Table = Table;
+
+	return Snapshot;
+}
+
+// Return to a snapshot and write its stacks in order to OutStacks
+void FInventoryStateTracker::Restore(const FInventoryStateSnapshot& Snapshot, TArray<FInventoryStruct>& OutStacks)
+{
+	// Still shared with the snapshot, the next change copies
+	Table = ConstCastSharedPtr<FInventoryStateChunkTable>(Snapshot.Table);
+	RebuildLookups();
+
+	TArray<const FInventoryStateSlot*> UsedSlots;
+	UsedSlots.Reserve(SlotIndices.Num());
+
+	for (const TSharedPtr<FInventoryStateChunkTable::FChunk>& Chunk : Table->Chunks)
+	{
+		for (const FInventoryStateSlot& Slot : Chunk->Slots)
+		{
+			if (Slot.bUsed)
+			{
+				UsedSlots.Add(&Slot);
+			}
+		}
+	}
+
+	UsedSlots.Sort([](const FInventoryStateSlot& One, const FInventoryStateSlot& Two) {
+		return One.OrderKey < Two.OrderKey;
+	});
+
+	OutStacks.Reset(UsedSlots.Num());
+	for (const FInventoryStateSlot* Slot : UsedSlots)
+	{
+		OutStacks.Add(Slot->Stack);
+	}
+}
+
+// Memory of the current table and its chunks, chunks shared with snapshots included
+SIZE_T FInventoryStateTracker::GetAllocatedSize() const
+{
+	if (!Table.IsValid())
+		return SlotIndices.GetAllocatedSize() + FreeSlots.GetAllocatedSize();
+
+	return sizeof(FInventoryStateChunkTable) + Table->Chunks.GetAllocatedSize() + (Table->Chunks.Num() * sizeof(FInventoryStateChunkTable::FChunk))
+		+ SlotIndices.GetAllocatedSize() + FreeSlots.GetAllocatedSize();
+}
+
+// Slot ready for writing, copies the table and chunk first if a snapshot shares them
+FInventoryStateSlot& FInventoryStateTracker::GetMutableSlot(int32 SlotIndex)
+{
+	if (!Table.IsUnique())
+	{
+		Table = MakeShareable(new FInventoryStateChunkTable(*Table));
+	}
+
+	TSharedPtr<FInventoryStateChunkTable::FChunk>& Chunk = Table->Chunks[SlotIndex / FInventoryStateChunkTable::ChunkSize];
+	if (!Chunk.IsUnique())
+	{
+		Chunk = MakeShareable(new FInventoryStateChunkTable::FChunk(*Chunk));
+	}
+
+	return Chunk->Slots[SlotIndex % FInventoryStateChunkTable::ChunkSize];
+}
+
+// Rebuild the lookups from the table
+void FInventoryStateTracker::RebuildLookups()
+{
+	SlotIndices.Reset();
+	FreeSlots.Reset();
+	NumSlots = Table->Chunks.Num() * FInventoryStateChunkTable::ChunkSize;
+	NextOrderKey = 0;
+
+	for (int32 SlotIndex = NumSlots - 1; SlotIndex >= 0; SlotIndex--)
+	{
+		const FInventoryStateSlot& Slot = Table->Chunks[SlotIndex / FInventoryStateChunkTable::ChunkSize]->Slots[SlotIndex % FInventoryStateChunkTable::ChunkSize];
+
+		if (Slot.bUsed)
+		{
+			SlotIndices.Add(Slot.Stack.UniqueID, SlotIndex);
+			NextOrderKey = FMath::Max(NextOrderKey, Slot.OrderKey + 1);
+		}
+		else
+		{
+			// Popped from the back, so low slots are reused first
+			FreeSlots.Add(SlotIndex);
+		}
+	}
+}
@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryUseManager.h"
+#include "InventoryComponent.h"
+#include "Item.h"
+#include "Engine/World.h"
+
+TMap<TWeakObjectPtr<UWorld>, TWeakObjectPtr<AInventoryUseManager>> AInventoryUseManager::WorldManagers;
+
+// Constructor
+AInventoryUseManager::AInventoryUseManager(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	// Run after gameplay so all uses of a frame end up in the same batch
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	bReplicates = false;
+}
+
+// Find or spawn the manager of a world
+AInventoryUseManager* AInventoryUseManager::Get(UWorld* World)
+{
+	if (!World)
+		return nullptr;
+
+	if (TWeakObjectPtr<AInventoryUseManager>* Manager = WorldManagers.Find(World))
+	{
+		if (Manager->IsValid())
+			return Manager->Get();
+	}
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnInfo.ObjectFlags |= RF_Transient;
+	AInventoryUseManager* NewManager = World->SpawnActor<AInventoryUseManager>(SpawnInfo);
+
+	WorldManagers.Add(World, NewManager);
+
+	return NewManager;
+}
+
+// Queue one use of an item, OnUse runs with the next batch
+void AInventoryUseManager::EnqueueUse(UInventoryComponent* Inventory, TSubclassOf<AItem> ItemClass)
+{
+	FPendingUse& Use = PendingUses[PendingUses.AddDefaulted()];
+	Use.Inventory = Inventory;
+	Use.ItemClass = ItemClass;
+}
+
+// Notify the inventory when its cooldown of this class is over
+void AInventoryUseManager::StartCooldown(UInventoryComponent* Inventory, TSubclassOf<AItem> ItemClass, float Seconds)
+{
+	FUseTimer Timer;
+	Timer.Inventory = Inventory;
+	Timer.ItemClass = ItemClass;
+
+	TimerWheel.Schedule(SecondsToTicks(Seconds), Timer);
+}
+
+// Run the queued uses and advance the timer wheel
+void AInventoryUseManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	RunPendingUses();
+
+	TimerAccumulator += DeltaSeconds;
+	const uint64 Ticks = FMath::FloorToInt(TimerAccumulator / TimerResolution);
+	TimerAccumulator -= Ticks * TimerResolution;
+
+	if (Ticks > 0)
+	{
+		TimerWheel.Advance(Ticks, [this](const FUseTimer& Timer) { OnTimerExpired(Timer); });
+	}
+}
+
+// Called when the game ends or the manager is destroyed
+void AInventoryUseManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	WorldManagers.Remove(GetWorld());
+
+	for (AItem* Item : ActiveUseItems)
+	{
+		if (Item)
+		{
+			Item->Destroy();
+		}
+	}
+	ActiveUseItems.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Execute all uses queued since the last batch
+void AInventoryUseManager::RunPendingUses()
+{
+	if (PendingUses.Num() == 0)
+		return;
+
+	// Uses queued by OnUse itself run with the next batch
+	TArray<FPendingUse> Uses = MoveTemp(PendingUses);
+	PendingUses.Reset();
+
+	for (const FPendingUse& Use : Uses)
+	{
+		if (!Use.ItemClass)
+			continue;
+
+		// The temp item is owned by the actor that used it
+		FActorSpawnParameters SpawnInfo;
+		SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		SpawnInfo.Owner = Use.Inventory.IsValid() ? Use.Inventory->GetOwner() : nullptr;
+
+		const float Duration = Use.ItemClass->GetDefaultObject<AItem>()->UseDuration;
+
+		// Items with a duration stay alive until the duration is over
+		if (Duration > 0.f)
+		{
+			AItem* DurationItem = GetWorld()->SpawnActor<AItem>(Use.ItemClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnInfo);
+			if (!DurationItem)
+				continue;
+
+			DurationItem->OnUse();
+			ActiveUseItems.Add(DurationItem);
+
+			FUseTimer Timer;
+			Timer.Item = DurationItem;
+			TimerWheel.Schedule(SecondsToTicks(Duration), Timer);
+
+			continue;
+		}
+
+		// Every use gets its own temp item, OnUse may change or destroy it
+		AItem* TempItem = GetWorld()->SpawnActor<AItem>(Use.ItemClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnInfo);
+		if (!TempItem)
+			continue;
+
+		TempItem->OnUse();
+
+		// Destroy after use
+		if (!TempItem->IsPendingKill())
+		{
+			TempItem->Destroy();
+		}
+	}
+}
+
+// Amount of wheel ticks covering a duration in seconds
+uint64 AInventoryUseManager::SecondsToTicks(float Seconds) const
+{
+	return (uint64)FMath::Max(FMath::CeilToInt(Seconds / TimerResolution), 1);
+}
+
+// Called by the timer wheel
+void AInventoryUseManager::OnTimerExpired(const FUseTimer& Timer)
+{
+	if (Timer.Item.IsValid())
+	{
+		AItem* Item = Timer.Item.Get();
+		ActiveUseItems.RemoveSwap(Item);
+
+		Item->OnUseFinished();
+		Item->Destroy();
+
+		return;
+	}
+
+	if (Timer.Inventory.IsValid())
+	{
+		Timer.Inventory->FinishUseCooldown(Timer.ItemClass);
+	}
+}
@@ -0,0 +1,529 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryViewModel.h"
+
+// Show the slots of an inventory and follow its changes
+void UInventoryViewModel::Bind(UInventoryComponent* InInventory)
+{
+	Unbind();
+
+	Inventory = InInventory;
+	if (InInventory)
+	{
+		SlotChangedHandle = InInventory->OnSlotChanged.AddUObject(this, &UInventoryViewModel::HandleSlotChanged);
+		SlotRemovedHandle = InInventory->OnSlotRemoved.AddUObject(this, &UInventoryViewModel::HandleSlotRemoved);
+		SlotsResetHandle = InInventory->OnSlotsReset.AddUObject(this, &UInventoryViewModel::HandleSlotsReset);
+		SlotsReorderedHandle = InInventory->OnSlotsReordered.AddUObject(this, &UInventoryViewModel::HandleSlotsReordered);
+	}
+
+	HandleSlotsReset();
+}
+
+// Only show slots whose name contains NameFilter, and with bFilterByType only slots of that type
+void UInventoryViewModel::SetFilter(const FString& InNameFilter, bool bInFilterByType, EItemType Type)
+{
+	NameFilter = InNameFilter;
+	bFilterByType = bInFilterByType;
+	FilterType = Type;
+
+	RebuildView();
+	MarkReset();
+}
+
+// Sort the view, unsorted views keep the order of the inventory
+void UInventoryViewModel::SetSortMethod(ESortMethod InSortMethod, bool bInSorted)
+{
+	if ((SortMethod == InSortMethod) && (bSorted == bInSorted))
+		return;
+
+	SortMethod = InSortMethod;
+	bSorted = bInSorted;
+
+	RebuildViewWithMoves();
+}
+
+// Re-sort the view and mark the fewest slots as moved that bring the old order into the new one
+void UInventoryViewModel::RebuildViewWithMoves()
+{
+	TMap<int32, int32> OldIndices;
+	OldIndices.Reserve(View.Num());
+	for (int32 Index = 0; Index < View.Num(); Index++)
+	{
+		OldIndices.Add(View[Index], Index);
+	}
+
+	RebuildView();
+
+	// The slots on the longest increasing run of old indices keep their relative order, only the others move
+	const int32 NumSlots = View.Num();
+	TArray<int32> OldOrder;
+	OldOrder.SetNumUninitialized(NumSlots);
+	for (int32 Index = 0; Index < NumSlots; Index++)
+	{
+		OldOrder[Index] = OldIndices.FindChecked(View[Index]);
+	}
+
+	// Patience sorting, TailIndices[L] ends the best run of length L + 1
+	TArray<int32> TailIndices;
+	TArray<int32> Predecessors;
+	Predecessors.SetNumUninitialized(NumSlots);
+
+	for (int32 Index = 0; Index < NumSlots; Index++)
+	{
+		int32 Low = 0;
+		int32 High = TailIndices.Num();
+		while (Low < High)
+		{
+			const int32 Middle = (Low + High) / 2;
+			if (OldOrder[TailIndices[Middle]] < OldOrder[Index])
+			{
+				Low = Middle + 1;
+			}
+			else
+			{
+				High = Middle;
+			}
+		}
+
+		Predecessors[Index] = (Low > 0) ? TailIndices[Low - 1] : INDEX_NONE;
+		if (Low == TailIndices.Num())
+		{
+			TailIndices.Add(Index);
+		}
+		else
+		{
+			TailIndices[Low] = Index;
+		}
+	}
+
+	TBitArray<> bKeeps(false, NumSlots);
+	for (int32 Index = (TailIndices.Num() > 0) ? TailIndices.Last() : INDEX_NONE; Index != INDEX_NONE; Index = Predecessors[Index])
+	{
+		bKeeps[Index] = true;
+	}
+
+	// Slots inserted this frame are sent with their final position anyway
+	for (int32 Index = 0; Index < NumSlots; Index++)
+	{
+		if (!bKeeps[Index] && !PendingInserted.Contains(View[Index]))
+		{
+			PendingMoved.Add(View[Index]);
+			bDiffPending = true;
+		}
+	}
+}
+
+// Entry object of a view index, created on first access
+UInventoryViewEntry* UInventoryViewModel::GetEntry(int32 ViewIndex)
+{
+	if (!View.IsValidIndex(ViewIndex))
+		return nullptr;
+
+	const int32 UniqueID = View[ViewIndex];
+	UInventoryViewEntry*& Entry = LiveEntries.FindOrAdd(UniqueID);
+
+	if (!Entry)
+	{
+		Entry = (EntryPool.Num() > 0) ? EntryPool.Pop(false) : NewObject<UInventoryViewEntry>(this);
+		Entry->Stack = Slots.FindChecked(UniqueID).Stack;
+	}
+
+	return Entry;
+}
+
+// Entry objects of a window of the view, entries outside the window are recycled
+void UInventoryViewModel::GetEntryWindow(int32 FirstIndex, int32 Count, TArray<UInventoryViewEntry*>& OutEntries)
+{
+	OutEntries.Reset();
+
+	const int32 Start = FMath::Clamp(FirstIndex, 0, View.Num());
+	const int32 End = FMath::Clamp(FirstIndex + Count, Start, View.Num());
+
+	TSet<int32> WindowIDs;
+	WindowIDs.Reserve(End - Start);
+	for (int32 Index = Start; Index < End; Index++)
+	{
+		WindowIDs.Add(View[Index]);
+	}
+
+	TArray<int32> OutsideIDs;
+	for (const TPair<int32, UInventoryViewEntry*>& Entry : LiveEntries)
+	{
+		if (!WindowIDs.Contains(Entry.Key))
+		{
+			OutsideIDs.Add(Entry.Key);
+		}
+	}
+
+	for (int32 UniqueID : OutsideIDs)
+	{
+		ReleaseEntry(UniqueID);
+	}
+
+	OutEntries.Reserve(End - Start);
+	for (int32 Index = Start; Index < End; Index++)
+	{
+		OutEntries.Add(GetEntry(Index));
+	}
+}
+
+// View index of a slot, -1 if it is filtered out
+int32 UInventoryViewModel::FindViewIndex(int32 UniqueID) const
+{
+	const FViewSlot* Slot = Slots.Find(UniqueID);
+	if (!Slot || !Slot->bVisible)
+		return INDEX_NONE;
+
+	const int32 Index = FindInsertIndex(*Slot, UniqueID);
+
+	return (View.IsValidIndex(Index) && (View[Index] == UniqueID)) ? Index : INDEX_NONE;
+}
+
+void UInventoryViewModel::BeginDestroy()
+{
+	Unbind();
+
+	Super::BeginDestroy();
+}
+
+// Send the collected changes
+void UInventoryViewModel::Tick(float DeltaTime)
+{
+	FInventoryViewDiff Diff;
+	Diff.bReset = bPendingReset;
+
+	if (!bPendingReset)
+	{
+		Diff.Removed = PendingRemoved.Array();
+		Diff.Inserted = PendingInserted.Array();
+		Diff.Updated = PendingUpdated.Array();
+
+		Diff.Moved.Reserve(PendingMoved.Num());
+		for (int32 UniqueID : PendingMoved)
+		{
+			FInventoryViewMove Move;
+			Move.UniqueID = UniqueID;
+			Move.ToIndex = FindViewIndex(UniqueID);
+			Diff.Moved.Add(Move);
+		}
+
+		// Apply moves front to back
+		Diff.Moved.Sort([](const FInventoryViewMove& One, const FInventoryViewMove& Two) {
+			return One.ToIndex < Two.ToIndex;
+		});
+	}
+
+	PendingRemoved.Reset();
+	PendingInserted.Reset();
+	PendingUpdated.Reset();
+	PendingMoved.Reset();
+	bPendingReset = false;
+	bDiffPending = false;
+
+	OnViewChanged.Broadcast(Diff);
+}
+
+// Stop following the bound inventory
+void UInventoryViewModel::Unbind()
+{
+	if (UInventoryComponent* BoundInventory = Inventory.Get())
+	{
+		BoundInventory->OnSlotChanged.Remove(SlotChangedHandle);
+		BoundInventory->OnSlotRemoved.Remove(SlotRemovedHandle);
+		BoundInventory->OnSlotsReset.Remove(SlotsResetHandle);
+		BoundInventory->OnSlotsReordered.Remove(SlotsReorderedHandle);
+	}
+
+	Inventory.Reset();
+}
+
+bool UInventoryViewModel::PassesFilter(const FViewSlot& Slot) const
+{
+	if (bFilterByType && (Slot.Stack.ItemType != FilterType))
+		return false;
+
+	return NameFilter.IsEmpty() || Slot.Name.Contains(NameFilter);
+}
+
+// Order of two slots in the view, inventory positions break ties so the order is total
+bool UInventoryViewModel::IsBefore(const FViewSlot& One, int32 OneID, const FViewSlot& Two, int32 TwoID) const
+{
+	// Same keys as the inventory sorting
+	if (bSorted)
+	{
+		switch (SortMethod)
+		{
+		case ESortMethod::NAME :
+		{
+			const int32 Compare = One.Name.Compare(Two.Name);
+			if (Compare != 0)
+				return Compare < 0;
+		}
+		break;
+
+		case ESortMethod::WEIGHT :
+			if (One.Stack.ItemWeight != Two.Stack.ItemWeight)
+				return One.Stack.ItemWeight < Two.Stack.ItemWeight;
+			break;
+
+		case ESortMethod::AMOUNT :
+			if (One.Stack.ItemAmount != Two.Stack.ItemAmount)
+				return One.Stack.ItemAmount < Two.Stack.ItemAmount;
+			break;
+
+		default:
+			if (One.Stack.SortPriority != Two.Stack.SortPriority)
+				return One.Stack.SortPriority < Two.Stack.SortPriority;
+			break;
+		}
+	}
+
+	if (One.Order != Two.Order)
+		return One.Order < Two.Order;
+
+	return OneID < TwoID;
+}
+
+// First view index not before the slot
+int32 UInventoryViewModel::FindInsertIndex(const FViewSlot& Slot, int32 UniqueID) const
+{
+	int32 Low = 0;
+	int32 High = View.Num();
+
+	while (Low < High)
+	{
+		const int32 Middle = (Low + High) / 2;
+		const int32 MiddleID = View[Middle];
+
+		if (IsBefore(Slots.FindChecked(MiddleID), MiddleID, Slot, UniqueID))
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+
+	return Low;
+}
+
+void UInventoryViewModel::HandleSlotChanged(const FInventoryStruct& Stack)
+{
+	const int32 UniqueID = Stack.UniqueID;
+
+	// Take the slot out with its old keys
+	const int32 OldIndex = FindViewIndex(UniqueID);
+	if (OldIndex != INDEX_NONE)
+	{
+		View.RemoveAt(OldIndex, 1, false);
+	}
+
+	FViewSlot* ExistingSlot = Slots.Find(UniqueID);
+	FViewSlot& Slot = ExistingSlot ? *ExistingSlot : Slots.Add(UniqueID);
+	if (!ExistingSlot)
+	{
+		Slot.Order = NextOrder++;
+	}
+
+	const bool bNameChanged = !Slot.Stack.ItemName.EqualTo(Stack.ItemName) || Slot.Name.IsEmpty();
+	Slot.Stack = Stack;
+	if (bNameChanged)
+	{
+		Slot.Name = Stack.ItemName.ToString();
+	}
+	Slot.bVisible = PassesFilter(Slot);
+
+	if (UInventoryViewEntry* Entry = LiveEntries.FindRef(UniqueID))
+	{
+		Entry->Stack = Stack;
+	}
+
+	if (Slot.bVisible)
+	{
+		const int32 NewIndex = FindInsertIndex(Slot, UniqueID);
+		View.Insert(UniqueID, NewIndex);
+
+		if (OldIndex != INDEX_NONE)
+		{
+			MarkUpdated(UniqueID, NewIndex != OldIndex);
+		}
+		else
+		{
+			MarkInserted(UniqueID);
+		}
+	}
+	else if (OldIndex != INDEX_NONE)
+	{
+		ReleaseEntry(UniqueID);
+		MarkRemoved(UniqueID);
+	}
+}
+
+void UInventoryViewModel::HandleSlotRemoved(int32 UniqueID)
+{
+	const int32 OldIndex = FindViewIndex(UniqueID);
+	if (OldIndex != INDEX_NONE)
+	{
+		View.RemoveAt(OldIndex, 1, false);
+		ReleaseEntry(UniqueID);
+		MarkRemoved(UniqueID);
+	}
+
+	Slots.Remove(UniqueID);
+}
+
+// Read all slots again
+void UInventoryViewModel::HandleSlotsReset()
+{
+	Slots.Reset();
+	NextOrder = 0;
+
+	if (UInventoryComponent* BoundInventory = Inventory.Get())
+	{
+		Slots.Reserve(BoundInventory->ItemArray.Num());
+
+		for (const FInventoryStruct& Stack : BoundInventory->ItemArray)
+		{
+			FViewSlot& Slot = Slots.Add(Stack.UniqueID);
+			Slot.Stack = Stack;
+			Slot.Name = Stack.ItemName.ToString();
+			Slot.Order = NextOrder++;
+		}
+	}
+
+	// Entries of slots that are gone go back to the pool, the others get the new state
+	TArray<int32> StaleIDs;
+	for (const TPair<int32, UInventoryViewEntry*>& Entry : LiveEntries)
+	{
+		if (const FViewSlot* Slot = Slots.Find(Entry.Key))
+		{
+			Entry.Value->Stack = Slot->Stack;
+		}
+		else
+		{
+			StaleIDs.Add(Entry.Key);
+		}
+	}
+
+	for (int32 UniqueID : StaleIDs)
+	{
+		ReleaseEntry(UniqueID);
+	}
+
+	RebuildView();
+	MarkReset();
+}
+
+// Take over the new inventory positions and only move the slots that have to
+void UInventoryViewModel::HandleSlotsReordered()
+{
+	UInventoryComponent* BoundInventory = Inventory.Get();
+	if (!BoundInventory)
+		return;
+
+	const TArray<FInventoryStruct>& Stacks = BoundInventory->ItemArray;
+	for (int32 Index = 0; Index < Stacks.Num(); Index++)
+	{
+		if (FViewSlot* Slot = Slots.Find(Stacks[Index].UniqueID))
+		{
+			Slot->Order = Index;
+		}
+	}
+	NextOrder = Stacks.Num();
+
+	RebuildViewWithMoves();
+}
+
+// Recompute filter results and order of all slots
+void UInventoryViewModel::RebuildView()
+{
+	View.Reset(Slots.Num());
+
+	for (TPair<int32, FViewSlot>& Slot : Slots)
+	{
+		Slot.Value.bVisible = PassesFilter(Slot.Value);
+		if (Slot.Value.bVisible)
+		{
+			View.Add(Slot.Key);
+		}
+	}
+
+	View.Sort([this](int32 OneID, int32 TwoID) {
+		return IsBefore(Slots.FindChecked(OneID), OneID, Slots.FindChecked(TwoID), TwoID);
+	});
+
+	// Filtered out slots don't keep their entries
+	TArray<int32> HiddenIDs;
+	for (const TPair<int32, UInventoryViewEntry*>& Entry : LiveEntries)
+	{
+		if (!Slots.FindChecked(Entry.Key).bVisible)
+		{
+			HiddenIDs.Add(Entry.Key);
+		}
+	}
+
+	for (int32 UniqueID : HiddenIDs)
+	{
+		ReleaseEntry(UniqueID);
+	}
+}
+
+// Give the entry of a slot back to the pool
+void UInventoryViewModel::ReleaseEntry(int32 UniqueID)
+{
+	UInventoryViewEntry* Entry = nullptr;
+	if (LiveEntries.RemoveAndCopyValue(UniqueID, Entry) && Entry)
+	{
+		EntryPool.Add(Entry);
+	}
+}
+
+void UInventoryViewModel::MarkInserted(int32 UniqueID)
+{
+	bDiffPending = true;
+
+	// Removed and inserted again in the same frame is an update
+	if (PendingRemoved.Remove(UniqueID) > 0)
+	{
+		PendingUpdated.Add(UniqueID);
+		PendingMoved.Add(UniqueID);
+		return;
+	}
+
+	PendingInserted.Add(UniqueID);
+}
+
+void UInventoryViewModel::MarkRemoved(int32 UniqueID)
+{
+	bDiffPending = true;
+
+	PendingUpdated.Remove(UniqueID);
+	PendingMoved.Remove(UniqueID);
+
+	// Inserted and removed in the same frame was never seen
+	if (PendingInserted.Remove(UniqueID) > 0)
+		return;
+
+	PendingRemoved.Add(UniqueID);
+}
+
+void UInventoryViewModel::MarkUpdated(int32 UniqueID, bool bMoved)
+{
+	bDiffPending = true;
+
+	if (PendingInserted.Contains(UniqueID))
+		return;
+
+	PendingUpdated.Add(UniqueID);
+	if (bMoved)
+	{
+		PendingMoved.Add(UniqueID);
+	}
+}
+
+void UInventoryViewModel::MarkReset()
+{
+	bDiffPending = true;
+	bPendingReset = true;
+}
@@ -0,0 +1,380 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventoryWorldItemRegistry.h"
+#include "InventoryPlugin.h"
+#include "Item.h"
+#include "Engine/World.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+
+TMap<TWeakObjectPtr<UWorld>, TWeakObjectPtr<AInventoryWorldItemRegistry>> AInventoryWorldItemRegistry::WorldRegistries;
+
+// Log the registry of the current world
+static FAutoConsoleCommandWithWorld WorldItemStatsCommand(
+	TEXT("Inventory.WorldItems.Stats"),
+	TEXT("Log world item record, instance and actor counts and memory"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (AInventoryWorldItemRegistry* Registry = AInventoryWorldItemRegistry::Get(World))
+		{
+			Registry->LogStats();
+		}
+	}));
+
+// Fill the registry with records for measuring, works headless
+static FAutoConsoleCommandWithWorldAndArgs WorldItemSpawnTestCommand(
+	TEXT("Inventory.WorldItems.SpawnTest"),
+	TEXT("Add <Count> world item records of <ItemClassPath> within <Radius> of the origin"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AInventoryWorldItemRegistry* Registry = AInventoryWorldItemRegistry::Get(World);
+		if (!Registry || Args.Num() < 2)
+			return;
+
+		UClass* ItemClass = StaticLoadClass(AItem::StaticClass(), nullptr, *Args[0]);
+		if (!ItemClass)
+		{
+			UE_LOG(LogInventory, Warning, TEXT("Item class %s not found"), *Args[0]);
+			return;
+		}
+
+		const int32 Count = FCString::Atoi(*Args[1]);
+		const float Radius = (Args.Num() > 2) ? FCString::Atof(*Args[2]) : 10000.f;
+
+		FRandomStream Stream(Count);
+		for (int32 Index = 0; Index < Count; Index++)
+		{
+			const FVector Location(Stream.FRandRange(-Radius, Radius), Stream.FRandRange(-Radius, Radius), 0.f);
+			Registry->AddWorldItem(ItemClass, 1, FTransform(Location));
+		}
+
+		Registry->LogStats();
+	}));
+
+// Constructor
+AInventoryWorldItemRegistry::AInventoryWorldItemRegistry(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	RootComponent = ObjectInitializer.CreateDefaultSubobject<USceneComponent>(this, TEXT("Root"));
+
+	bReplicates = false;
+}
+
+// Find or spawn the registry of a world
+AInventoryWorldItemRegistry* AInventoryWorldItemRegistry::Get(UWorld* World)
+{
+	if (!World)
+		return nullptr;
+
+	if (TWeakObjectPtr<AInventoryWorldItemRegistry>* Registry = WorldRegistries.Find(World))
+	{
+		if (Registry->IsValid())
+			return Registry->Get();
+	}
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnInfo.ObjectFlags |= RF_Transient;
+	AInventoryWorldItemRegistry* NewRegistry = World->SpawnActor<AInventoryWorldItemRegistry>(SpawnInfo);
+
+	WorldRegistries.Add(World, NewRegistry);
+
+	return NewRegistry;
+}
+
+// Store an item as record, returns its handle
+int32 AInventoryWorldItemRegistry::AddWorldItem(TSubclassOf<AItem> ItemClass, int32 Amount, const FTransform& Transform)
+{
+	if (!ItemClass || Amount <= 0)
+		return INDEX_NONE;
+
+	// The hash keeps the cell size it was built with
+	if (CellSize <= 0.f)
+	{
+		CellSize = PromotionRadius;
+	}
+
+	FClassInstances& Instances = FindOrAddInstances(ItemClass);
+
+	FWorldItemRecord Record;
+	Record.ItemClass = ItemClass;
+	Record.Amount = Amount;
+	Record.Transform = Transform;
+	Record.InstanceIndex = Instances.InstanceRecords.Num();
+	Record.Cell = GetCell(Transform.GetLocation());
+
+	const int32 Handle = Records.Add(Record);
+
+	Instances.InstanceRecords.Add(Handle);
+	if (Instances.Mesh)
+	{
+		Instances.Mesh->AddInstanceWorldSpace(Transform);
+	}
+
+	Cells.FindOrAdd(Record.Cell).Add(Handle);
+
+	return Handle;
+}
+
+// Remove a record without spawning anything
+bool AInventoryWorldItemRegistry::RemoveWorldItem(int32 Handle)
+{
+	if (!Records.IsValidIndex(Handle))
+		return false;
+
+	RemoveRecordInstance(Handle);
+	RemoveRecordFromCell(Handle);
+	Records.RemoveAt(Handle);
+
+	return true;
+}
+
+// Replace a record by a real item actor
+AItem* AInventoryWorldItemRegistry::PromoteWorldItem(int32 Handle)
+{
+	if (!Records.IsValidIndex(Handle))
+		return nullptr;
+
+	const FWorldItemRecord Record = Records[Handle];
+
+	// Set the amount before BeginPlay
+	AItem* Item = GetWorld()->SpawnActorDeferred<AItem>(Record.ItemClass, Record.Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (!Item)
+		return nullptr;
+
+	Item->PickupAmount = Record.Amount;
+	Item->FinishSpawning(Record.Transform);
+
+	RemoveWorldItem(Handle);
+	PromotedItems.Add(Item);
+
+	return Item;
+}
+
+// Replace an item actor by a record, returns its handle
+int32 AInventoryWorldItemRegistry::DemoteItem(AItem* Item)
+{
+	if (!Item || Item->IsPendingKill())
+		return INDEX_NONE;
+
+	const int32 Handle = AddWorldItem(Item->GetClass(), Item->PickupAmount, Item->GetActorTransform());
+	if (Handle == INDEX_NONE)
+		return INDEX_NONE;
+
+	PromotedItems.RemoveSwap(Item);
+	Item->Destroy();
+
+	return Handle;
+}
+
+// Bytes allocated for records, spatial cells and instance lookups
+SIZE_T AInventoryWorldItemRegistry::GetAllocatedSize() const
+{
+	SIZE_T Size = Records.GetAllocatedSize() + Cells.GetAllocatedSize() + ClassInstances.GetAllocatedSize() + PromotedItems.GetAllocatedSize();
+
+	for (const TPair<FIntPoint, TArray<int32>>& Cell : Cells)
+	{
+		Size += Cell.Value.GetAllocatedSize();
+	}
+
+	for (const TPair<UClass*, FClassInstances>& Instances : ClassInstances)
+	{
+		Size += Instances.Value.InstanceRecords.GetAllocatedSize();
+		if (Instances.Value.Mesh)
+		{
+			Size += Instances.Value.Mesh->PerInstanceSMData.GetAllocatedSize();
+		}
+	}
+
+	return Size;
+}
+
+// Log record, instance and actor counts
+void AInventoryWorldItemRegistry::LogStats() const
+{
+	UE_LOG(LogInventory, Display, TEXT("World items: %d records in %d classes and %d cells, %d promoted actors, %d actors in world, %.1f KB"),
+		Records.Num(), ClassInstances.Num(), Cells.Num(), PromotedItems.Num(), GetWorld()->GetActorCount(), GetAllocatedSize() / 1024.f);
+}
+
+// Check all pawns against nearby records and promoted actors
+void AInventoryWorldItemRegistry::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	// Only the authority spawns real items
+	if (GetWorld()->GetNetMode() == NM_Client)
+		return;
+
+	TimeSinceUpdate += DeltaSeconds;
+	if (TimeSinceUpdate < UpdateInterval)
+		return;
+
+	TimeSinceUpdate = 0.f;
+
+	TArray<FVector> PawnLocations;
+	for (FConstPawnIterator Iterator = GetWorld()->GetPawnIterator(); Iterator; ++Iterator)
+	{
+		if (APawn* Pawn = Iterator->Get())
+		{
+			PawnLocations.Add(Pawn->GetActorLocation());
+		}
+	}
+
+	DemoteDistantItems(PawnLocations);
+
+	if (Records.Num() == 0)
+		return;
+
+	for (const FVector& Location : PawnLocations)
+	{
+		PromoteRecordsNear(Location);
+	}
+}
+
+// Called when the game ends or the registry is destroyed
+void AInventoryWorldItemRegistry::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	WorldRegistries.Remove(GetWorld());
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Cell of the spatial hash containing a location
+FIntPoint AInventoryWorldItemRegistry::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+// Create the instanced mesh of a class from its default item mesh
+AInventoryWorldItemRegistry::FClassInstances& AInventoryWorldItemRegistry::FindOrAddInstances(UClass* ItemClass)
+{
+	if (FClassInstances* Existing = ClassInstances.Find(ItemClass))
+		return *Existing;
+
+	FClassInstances& Instances = ClassInstances.Add(ItemClass);
+
+	const UStaticMeshComponent* DefaultMesh = ItemClass->GetDefaultObject<AItem>()->ItemMesh;
+	if (!DefaultMesh || !DefaultMesh->GetStaticMesh())
+		return Instances;
+
+	// Records are only drawn, pickup collision comes with promotion
+	UHierarchicalInstancedStaticMeshComponent* Mesh = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+	Mesh->SetStaticMesh(DefaultMesh->GetStaticMesh());
+	for (int32 MaterialIndex = 0; MaterialIndex < DefaultMesh->GetNumMaterials(); MaterialIndex++)
+	{
+		Mesh->SetMaterial(MaterialIndex, DefaultMesh->GetMaterial(MaterialIndex));
+	}
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Mesh->SetupAttachment(RootComponent);
+	Mesh->RegisterComponent();
+
+	Instances.Mesh = Mesh;
+	InstanceMeshes.Add(Mesh);
+
+	return Instances;
+}
+
+// Remove the instance of a record, the last instance of its class takes its place
+void AInventoryWorldItemRegistry::RemoveRecordInstance(int32 Handle)
+{
+	const FWorldItemRecord& Record = Records[Handle];
+	FClassInstances& Instances = ClassInstances.FindChecked(Record.ItemClass);
+
+	// Only ever remove the last instance so no other instance index shifts
+	const int32 LastIndex = Instances.InstanceRecords.Num() - 1;
+	if (Record.InstanceIndex != LastIndex)
+	{
+		const int32 LastHandle = Instances.InstanceRecords[LastIndex];
+		Instances.InstanceRecords[Record.InstanceIndex] = LastHandle;
+		Records[LastHandle].InstanceIndex = Record.InstanceIndex;
+
+		if (Instances.Mesh)
+		{
+			Instances.Mesh->UpdateInstanceTransform(Record.InstanceIndex, Records[LastHandle].Transform, true, false);
+		}
+	}
+
+	Instances.InstanceRecords.Pop(false);
+	if (Instances.Mesh)
+	{
+		Instances.Mesh->RemoveInstance(LastIndex);
+	}
+}
+
+// Remove a record from its spatial cell
+void AInventoryWorldItemRegistry::RemoveRecordFromCell(int32 Handle)
+{
+	const FIntPoint Cell = Records[Handle].Cell;
+
+	TArray<int32>& CellHandles = Cells.FindChecked(Cell);
+	CellHandles.RemoveSingleSwap(Handle, false);
+
+	if (CellHandles.Num() == 0)
+	{
+		Cells.Remove(Cell);
+	}
+}
+
+// Promote all records within PromotionRadius of a location
+void AInventoryWorldItemRegistry::PromoteRecordsNear(const FVector& Location)
+{
+	const FIntPoint Center = GetCell(Location);
+	const int32 CellRange = FMath::CeilToInt(PromotionRadius / CellSize);
+	const float RadiusSquared = FMath::Square(PromotionRadius);
+
+	TArray<int32> HandlesToPromote;
+
+	for (int32 CellY = Center.Y - CellRange; CellY <= Center.Y + CellRange; CellY++)
+	{
+		for (int32 CellX = Center.X - CellRange; CellX <= Center.X + CellRange; CellX++)
+		{
+			const TArray<int32>* CellHandles = Cells.Find(FIntPoint(CellX, CellY));
+			if (!CellHandles)
+				continue;
+
+			for (int32 Handle : *CellHandles)
+			{
+				if (FVector::DistSquared(Records[Handle].Transform.GetLocation(), Location) <= RadiusSquared)
+				{
+					HandlesToPromote.Add(Handle);
+				}
+			}
+		}
+	}
+
+	// Promoting changes the cells, so collect first
+	for (int32 Handle : HandlesToPromote)
+	{
+		PromoteWorldItem(Handle);
+	}
+}
+
+// Demote promoted actors no pawn is close to anymore
+void AInventoryWorldItemRegistry::DemoteDistantItems(const TArray<FVector>& PawnLocations)
+{
+	const float RadiusSquared = FMath::Square(FMath::Max(DemotionRadius, PromotionRadius));
+
+	for (int32 Index = PromotedItems.Num() - 1; Index >= 0; Index--)
+	{
+		// Picked up or destroyed otherwise
+		AItem* Item = PromotedItems[Index].Get();
+		if (!Item || Item->IsPendingKill())
+		{
+			PromotedItems.RemoveAtSwap(Index);
+			continue;
+		}
+
+		const FVector ItemLocation = Item->GetActorLocation();
+		const bool bPawnNearby = PawnLocations.ContainsByPredicate([&ItemLocation, RadiusSquared](const FVector& PawnLocation) {
+			return FVector::DistSquared(PawnLocation, ItemLocation) <= RadiusSquared;
+		});
+
+		if (!bPawnNearby)
+		{
+			DemoteItem(Item);
+		}
+	}
+}
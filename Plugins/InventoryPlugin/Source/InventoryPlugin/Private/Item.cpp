@@ -24,4 +24,9 @@ void AItem::BeginPlay()
 void AItem::OnUse_Implementation()
 {
 
-}
\ No newline at end of file
+}
+
+void AItem::OnUseFinished_Implementation()
+{
+
+}
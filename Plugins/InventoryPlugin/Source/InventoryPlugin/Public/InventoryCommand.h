@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "InventoryCommand.generated.h"
+
+// Operation requested by an owning client
+UENUM(BlueprintType)
+enum class EInventoryCommandType : uint8
+{
+	SPLIT,
+	COMBINE,
+	MOVE,
+	DROP,
+	USE
+};
+
+// One inventory operation sent from the owning client to the server, stacks are addressed by unique ID
+USTRUCT(BlueprintType)
+struct FInventoryCommand
+{
+	GENERATED_BODY()
+
+	// Sequence number used by the server to acknowledge commands
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory Command")
+		int32 Sequence;
+
+	// Operation to execute
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory Command")
+		EInventoryCommandType Type;
+
+	// Stack the operation works on
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory Command")
+		int32 UniqueID;
+
+	// Second stack for combine, unique ID predicted by the client for split
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory Command")
+		int32 OtherUniqueID;
+
+	// Split amount, grid column or array index for move
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory Command")
+		int32 Amount;
+
+	// Grid row for move
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory Command")
+		int32 Target;
+
+	// Default Constructor
+	FInventoryCommand()
+	{
+		Sequence = 0;
+		Type = EInventoryCommandType::USE;
+		UniqueID = -1;
+		OtherUniqueID = -1;
+		Amount = 0;
+		Target = 0;
+	}
+
+	// Constructor
+	FInventoryCommand(EInventoryCommandType InType, int32 InUniqueID, int32 InOtherUniqueID, int32 InAmount, int32 InTarget)
+	{
+		Sequence = 0;
+		Type = InType;
+		UniqueID = InUniqueID;
+		OtherUniqueID = InOtherUniqueID;
+		Amount = InAmount;
+		Target = InTarget;
+	}
+};
@@ -5,6 +5,13 @@
 #include "EngineMinimal.h"
 #include "Components/ActorComponent.h"
 #include "Item.h"
+#include "InventoryGrid.h"
+#include "InventoryCommand.h"
+#include "InventoryRecorder.h"
+#include "InventorySnapshot.h"
+#include "InventoryStateTracker.h"
+#include "InventoryItemDatabase.h"
+#include "InventoryEquipmentTable.h"
 #include "InventoryComponent.generated.h"
 
 //
@@ -17,6 +24,23 @@ enum class ESortMethod : uint8
 	PRIORITY
 };
 
+// Value the pickup planner maximizes
+UENUM(BlueprintType)
+enum class EPickupValueMethod : uint8
+{
+	PRIORITY,
+	AMOUNT,
+	WEIGHT
+};
+
+// Placement strategy used when a stack is put into the grid
+UENUM(BlueprintType)
+enum class EGridPlacement : uint8
+{
+	FIRST_FIT,
+	BEST_FIT
+};
+
 // Represents one slot in the inventory
 USTRUCT(BlueprintType)
 struct FInventoryStruct
@@ -55,10 +79,14 @@ struct FInventoryStruct
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory Structure")
 		int32 WeightBonus;
 
-	// Unique identifier for this slot
+	// Unique identifier for this slot within its inventory
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory Structure")
 		int32 UniqueID;
 
+	// Identifier of this stack across all inventories and servers, kept when the stack moves, 0 if none
+	UPROPERTY()
+		int64 GlobalID;
+
 	// Sort priority used for default sorting
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory Structure")
 		int32 SortPriority;
@@ -67,6 +95,22 @@ struct FInventoryStruct
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Inventory|Item")
 		EItemType ItemType = EItemType::DEFAULT;
 
+	// Width of this stack in grid inventory cells
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory Structure")
+		int32 GridWidth;
+
+	// Height of this stack in grid inventory cells
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory Structure")
+		int32 GridHeight;
+
+	// Grid column of the top left cell, -1 if not placed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory Structure")
+		int32 GridX;
+
+	// Grid row of the top left cell, -1 if not placed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory Structure")
+		int32 GridY;
+
 	// Default Constructor
 	FInventoryStruct()
 	{
@@ -76,8 +120,13 @@ struct FInventoryStruct
 		ItemWeight = -1;
 		WeightBonus = -1;
 		UniqueID = -1;
+		GlobalID = 0;
 		SortPriority = 0;
 		ItemType = EItemType::DEFAULT;
+		GridWidth = 1;
+		GridHeight = 1;
+		GridX = -1;
+		GridY = -1;
 	}
 
 	// Constructor
@@ -93,12 +142,85 @@ struct FInventoryStruct
 		ItemThumbnail = InItemThumbnail;
 		WeightBonus = InItemWeightBonus;
 		UniqueID = InUniqueID;
+		GlobalID = 0;
 		SortPriority = InSortPriority;
 		ItemType = InItemType;
+		GridWidth = 1;
+		GridHeight = 1;
+		GridX = -1;
+		GridY = -1;
+	}
+};
+
+// Amount of one item in the scene the pickup planner decided to take
+USTRUCT(BlueprintType)
+struct FPickupPlanEntry
+{
+	GENERATED_BODY()
+
+	// Item in the scene to pick up from
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory Structure")
+		AItem* Item;
+
+	// Amount of units to take from this item
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory Structure")
+		int32 Amount;
+
+	// Default Constructor
+	FPickupPlanEntry()
+	{
+		Item = nullptr;
+		Amount = 0;
+	}
+
+	// Constructor
+	FPickupPlanEntry(AItem* InItem, int32 InAmount)
+	{
+		Item = InItem;
+		Amount = InAmount;
+	}
+};
+
+// Memory held by one inventory component, filled by GetMemoryUsage
+struct FInventoryMemoryUsage
+{
+	// Size of the component object itself
+	SIZE_T ComponentBytes = 0;
+
+	// Stacks in use
+	SIZE_T StackBytes = 0;
+
+	// Allocated but unused stack capacity
+	SIZE_T SlackBytes = 0;
+
+	// Text payloads of names and descriptions, shared texts are counted once per report
+	SIZE_T TextBytes = 0;
+
+	// Replication copy, command queues and lookup maps
+	SIZE_T OtherBytes = 0;
+
+	int32 NumStacks = 0;
+
+	SIZE_T GetTotalBytes() const { return ComponentBytes + StackBytes + SlackBytes + TextBytes + OtherBytes; }
+
+	FInventoryMemoryUsage& operator+=(const FInventoryMemoryUsage& Other)
+	{
+		ComponentBytes += Other.ComponentBytes;
+		StackBytes += Other.StackBytes;
+		SlackBytes += Other.SlackBytes;
+		TextBytes += Other.TextBytes;
+		OtherBytes += Other.OtherBytes;
+		NumStacks += Other.NumStacks;
+
+		return *this;
 	}
 };
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FInventoryOutOfSpaceDelegate);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FInventoryUseCooldownDelegate, TSubclassOf<class AItem>, ItemClass);
+DECLARE_MULTICAST_DELEGATE_OneParam(FInventorySlotChangedDelegate, const FInventoryStruct&);
+DECLARE_MULTICAST_DELEGATE_OneParam(FInventorySlotRemovedDelegate, int32);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FInventoryClassTotalChangedDelegate, UClass*, int32);
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class INVENTORYPLUGIN_API UInventoryComponent : public UActorComponent
@@ -113,14 +235,34 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 		bool AddItem(AItem* InItem);
 
+	// Add an item from its class defaults without an actor in the scene, returns the amount added
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		int32 AddItemFromClass(TSubclassOf<class AItem> ItemClass, int32 Amount);
+
+	// Choose how much of each candidate to pick up so the chosen value is maximized within the remaining capacity
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		bool PlanPickup(const TArray<AItem*>& Candidates, EPickupValueMethod ValueMethod, TArray<FPickupPlanEntry>& OutPlan);
+
+	// Pick up the amounts of a plan created by PlanPickup
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		bool ApplyPickupPlan(const TArray<FPickupPlanEntry>& Plan);
+
 	// Remove an item from the inventory
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 		bool DropItem(FInventoryStruct InInventoryStruct);
 
-	// Remove an item from the inventory
+	// Use an item of this class, the use event runs with the next batch, fails while the class is on cooldown
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 		bool UseItem(TSubclassOf<class AItem> ItemClass);
 
+	// Check if items of this class can't be used right now
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+		bool IsItemOnCooldown(TSubclassOf<class AItem> ItemClass) const;
+
+	// Seconds until items of this class can be used again
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+		float GetRemainingCooldown(TSubclassOf<class AItem> ItemClass) const;
+
 	// Sort all items in the inventory
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 		bool SortInventory(ESortMethod SortMethod);
@@ -137,10 +279,113 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 		bool RemoveFromStack(int32 StackIndex, int32 Amount, bool RemoveWholeStack);
 
+	// Remove an amount of a class over as many stacks as needed, smallest stacks first, nothing is removed if there are not enough
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		bool ConsumeItems(TSubclassOf<class AItem> ItemClass, int32 Amount);
+
+	// Move an amount of a stack to another inventory, merged into its open stacks, nothing moves unless all of it fits
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Transfer")
+		bool TransferTo(UInventoryComponent* Destination, int32 UniqueID, int32 Amount);
+
+	// Move whole stacks to another inventory in one step, all or nothing, each side tells its listeners once
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Transfer")
+		bool TransferStacksTo(UInventoryComponent* Destination, const TArray<int32>& UniqueIDs);
+
+	// Move every stack to another inventory, all or nothing
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Transfer")
+		bool TransferAllTo(UInventoryComponent* Destination);
+
+	// Rebuild grid occupancy from the stacks and place stacks that have no valid position yet
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Grid")
+		void RebuildGrid();
+
+	// Repack all stacks in the grid, largest first
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Grid")
+		bool ArrangeGrid();
+
+	// Check if a stack could be moved to a grid position
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Grid")
+		bool CanPlaceStackAt(int32 StackIndex, int32 X, int32 Y);
+
+	// Move a stack to a grid position
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Grid")
+		bool MoveStackInGrid(int32 StackIndex, int32 X, int32 Y);
+
+	// Network requests, exercise them on a listen server with the "Net PktLag" and "Net PktLoss" console commands
+	// Split a stack, predicted on the owning client and batched to the server
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Network")
+		bool RequestSplitStack(int32 UniqueID, int32 SplitAmount);
+
+	// Combine the second stack into the first, predicted on the owning client and batched to the server
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Network")
+		bool RequestCombineStack(int32 FirstUniqueID, int32 SecondUniqueID);
+
+	// Move a stack to a grid position (or to array index X without grid), predicted and batched
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Network")
+		bool RequestMoveStack(int32 UniqueID, int32 X, int32 Y);
+
+	// Drop a whole stack, predicted and batched, the item is only spawned by the server
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Network")
+		bool RequestDropStack(int32 UniqueID);
+
+	// Use one item of a stack, predicted and batched, OnUse only runs on the server
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Network")
+		bool RequestUseStack(int32 UniqueID);
+
+	// Rebuild the inventory from the latest journal snapshot and the records written after it
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Journal")
+		bool RecoverFromJournal();
+
+	// Write the current inventory as journal snapshot and start a new journal
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Journal")
+		void CompactJournal();
+
+	// Start writing every inventory operation to Saved/InventoryRecordings/<Name>.invrec
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Recording")
+		bool StartRecording(const FString& Name);
+
+	// Stop and close the current recording
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Recording")
+		void StopRecording();
+
 	// Find Item Stack by Unique ID
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 		bool FindItemStackByUniqueID(int32 InStackID, FInventoryStruct& OutStack, int32& OutIndex);
 	
+	// Item definitions used by the tag queries, the tag totals follow the database when it is edited
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Tags")
+		UInventoryItemDatabase* ItemDatabase = nullptr;
+
+	// Amount of items of a class over all stacks, O(1)
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+		int32 GetItemCount(TSubclassOf<class AItem> ItemClass) const;
+
+	// Amount of items with a tag or one of its child tags, O(1)
+	UFUNCTION(BlueprintPure, Category = "Inventory|Tags")
+		int32 GetItemCountWithTag(FGameplayTag Tag) const;
+
+	// Check if any item matches the query
+	UFUNCTION(BlueprintPure, Category = "Inventory|Tags")
+		bool HasItemMatching(const FInventoryTagQuery& Query) const;
+
+	// Amount of items matching the query
+	UFUNCTION(BlueprintPure, Category = "Inventory|Tags")
+		int32 GetItemCountMatching(const FInventoryTagQuery& Query) const;
+
+	// Unique IDs of all stacks matching the query
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Tags")
+		void FindStacksMatching(const FInventoryTagQuery& Query, TArray<int32>& OutUniqueIDs) const;
+
+	// Global ID of a stack, 0 if there is no stack with this unique ID
+	int64 GetGlobalStackID(int32 InStackID) const;
+
+	// Unique ID of the stack with a global ID in this inventory, -1 if it is not here
+	int32 FindUniqueIDByGlobalID(int64 GlobalID) const;
+
+	// Global ID of a stack as text, Blueprints have no 64 bit integers
+	UFUNCTION(BlueprintPure, Category = "Inventory")
+		FString GetGlobalStackIDString(int32 InStackID) const;
+
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 		bool FindStackByClass(TSubclassOf<class AItem> StackClass, bool bReturnFullStacks, FInventoryStruct& outStructure, int32& OutIndex);
 
@@ -151,6 +396,9 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Inventory")
 		int32 CalculateUniqueID();
 
+	// Global ID of a stack created in this inventory, 0 without authority, the server's ID arrives with its state
+	int64 GenerateGlobalID() const;
+
 	// Calculate total weight of one slot
 	UFUNCTION(BlueprintPure, Category = "Inventory")
 		int32 CalculateStackWeight(FInventoryStruct& outStructure);
@@ -163,29 +411,52 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
 		TArray<FInventoryStruct> ItemArray;
 
-	// Backpack Slot that increases inventory capacity
+	// Slots that backpacks, weapons and cosmetics are equipped to, null uses the default backpack, weapon and cosmetic slots
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Equipment")
+		UInventoryEquipmentTable* EquipmentTable = nullptr;
+
+	// Item in every slot of the equipment table by slot id, empty slots have no item class
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Inventory|Equipment")
+		TArray<FInventoryStruct> EquippedItems;
+
+	// Item of the slot named Backpack, kept for widgets made before equipment tables
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
 		FInventoryStruct EquippedBackpack;
 
-	// Weapon Slot
+	// Item of the slot named Weapon, kept for widgets made before equipment tables
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
 		FInventoryStruct EquippedWeapon;
 
-	// Cosmetic Slot
+	// Item of the slot named Cosmetic, kept for widgets made before equipment tables
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
 		FInventoryStruct EquippedCosmetic;
 
-	// Backpack Mesh
+	// Attached mesh of the slot named Backpack
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
-		UStaticMeshComponent* BackpackMesh;
+		UStaticMeshComponent* BackpackMesh = nullptr;
 
-	// Weapon Mesh
+	// Attached mesh of the slot named Weapon
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
-		UStaticMeshComponent* WeaponMesh;
+		UStaticMeshComponent* WeaponMesh = nullptr;
 
-	// Cosmetic Mesh
+	// Attached mesh of the slot named Cosmetic
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
-		UStaticMeshComponent* CosmeticMesh;
+		UStaticMeshComponent* CosmeticMesh = nullptr;
+
+	// Slot id of a slot name, INDEX_NONE if the table has no such slot
+	UFUNCTION(BlueprintPure, Category = "Inventory|Equipment")
+		int32 FindEquipmentSlot(FName SlotName) const;
+
+	// Item in a slot, false if the slot is empty
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Equipment")
+		bool GetEquippedItem(int32 SlotIndex, FInventoryStruct& OutItem) const;
+
+	// Drop the item of a slot into the scene
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Equipment")
+		bool UnequipSlot(int32 SlotIndex);
+
+	// The equipment table in use
+	const UInventoryEquipmentTable* GetEquipmentTable() const;
 
 	// All items in proximity
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
@@ -195,30 +466,289 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
 		int32 MaxIntentoryWeight = 50;
 
+	// Store items in a spatial grid in addition to the weight limit
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Grid")
+		bool bUseGrid = false;
+
+	// Amount of grid columns
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Grid", meta = (ClampMin = "1", ClampMax = "64"))
+		int32 GridColumns = 10;
+
+	// Amount of grid rows
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Grid", meta = (ClampMin = "1"))
+		int32 GridRows = 20;
+
+	// Strategy used to find a position for new stacks
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Grid")
+		EGridPlacement GridPlacement = EGridPlacement::FIRST_FIT;
+
+	// Journal every change on the server so it survives a crash, recovered on BeginPlay
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Journal")
+		bool bEnableJournal = false;
+
+	// File name of the journal, should identify the player or container across sessions, defaults to the owner name
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Journal")
+		FString JournalName;
+
+	// Amount of records after which the journal is compacted into a snapshot, checked once per frame
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Journal", meta = (ClampMin = "1"))
+		int32 JournalCompactionInterval = 1000;
+
+	// Drop items as lightweight world item records instead of actors, they become actors again when a pawn comes close
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
+		bool bDropAsWorldItem = false;
+
+	// Record the operation stream from BeginPlay on, replay it with the InventoryReplay commandlet
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Recording")
+		bool bRecordOperations = false;
+
+	// File name of the recording, defaults to the owner name
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Recording")
+		FString RecordingName;
+
 	UPROPERTY(BlueprintAssignable, Category = "Test")
 		FInventoryOutOfSpaceDelegate OnOutOfSpace;
 
+	// Called when items of a class can be used again
+	UPROPERTY(BlueprintAssignable, Category = "Inventory")
+		FInventoryUseCooldownDelegate OnUseCooldownFinished;
+
+	// Called by the use manager when a cooldown ran out
+	void FinishUseCooldown(TSubclassOf<class AItem> ItemClass);
+
+	// Called after a slot was added or changed, not for reordering
+	FInventorySlotChangedDelegate OnSlotChanged;
+
+	// Called after a slot was removed, with its unique ID
+	FInventorySlotRemovedDelegate OnSlotRemoved;
+
+	// Called after all slots were replaced at once
+	FSimpleMulticastDelegate OnSlotsReset;
+
+	// Called after the order of the slots changed, the slots themselves are the same
+	FSimpleMulticastDelegate OnSlotsReordered;
+
+	// Called with the new total when the amount of a class changed, only once the totals are in use
+	FInventoryClassTotalChangedDelegate OnClassTotalChanged;
+
+	// Stack capacity allocated with the first stack, small inventories never grow past it and empty ones allocate nothing
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Memory", meta = (ClampMin = "0"))
+		int32 MinStackCapacity = 16;
+
+	// Release capacity once less than 1 / ShrinkFactor of it is used, never below MinStackCapacity
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Memory", meta = (ClampMin = "2"))
+		int32 ShrinkFactor = 4;
+
+	// Publish an immutable snapshot after each frame with changes, for readers on other threads
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Threading")
+		bool bPublishSnapshots = false;
+
+	// Latest published snapshot, callable from any thread while the component is alive
+	FInventorySnapshotPtr GetSnapshot() const { return SnapshotPublisher->Read(); }
+
+	// Publisher to keep on worker threads, stays valid after the component is destroyed
+	FInventorySnapshotPublisherRef GetSnapshotPublisher() const { return SnapshotPublisher; }
+
+	// Share the current state for rollback, O(1), unchanged chunks stay shared between snapshots and the live state
+	FInventoryStateSnapshot CaptureState();
+
+	// Return to a captured state, not recorded or predicted, clients get the server state again with the next update
+	bool RestoreState(const FInventoryStateSnapshot& Snapshot);
+
+	// Remember the current state for UndoLastAction
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Undo")
+		void SaveUndoState();
+
+	// Return to the last saved state, false if there is none
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Undo")
+		bool UndoLastAction();
+
+	// Amount of undo states kept, the oldest is dropped first
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Undo", meta = (ClampMin = "1"))
+		int32 MaxUndoStates = 60;
+
+	// Add the memory of this inventory, SeenTexts keeps texts shared between stacks from being counted twice
+	void GetMemoryUsage(FInventoryMemoryUsage& OutUsage, TSet<const void*>& SeenTexts) const;
+
+	// Upper limit of commands accepted in one batch
+	static const int32 MaxCommandsPerBatch = 256;
+
+	// Predicted split IDs may run this far ahead of the server counter, covers the commands of a few batches in flight
+	static const int32 MaxPredictedUniqueIDs = 4 * MaxCommandsPerBatch;
+
+	// Called every frame
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
+	// Called when the game ends or the component is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 private:
+	// Execute a batch of client commands in sequence order
+	UFUNCTION(Server, Reliable, WithValidation)
+		void ServerExecuteCommands(const TArray<FInventoryCommand>& Commands);
+
+	// Authoritative state arrived, rewind to it and replay unacknowledged commands
+	UFUNCTION()
+		void OnRep_ServerState();
+
+	// Predict locally and queue for the server, or execute directly with authority
+	UFUNCTION()
+		bool SubmitCommand(FInventoryCommand Command);
+
+	// Whether the server can adopt a split ID predicted by the client
+	bool IsPredictedUniqueIDValid(int32 PredictedUniqueID) const;
+
+	// Apply one command to ItemArray, predicted commands skip spawning and OnUse
+	UFUNCTION()
+		bool ExecuteCommand(const FInventoryCommand& Command, bool bPredicted);
+
+	// Split a stack giving the new stack the given ID
+	UFUNCTION()
+		bool SplitStackWithID(int32 InIndex, int32 SplitAmount, int32 NewUniqueID);
+
+	// Remove one item from a stack and queue its use event
+	UFUNCTION()
+		bool UseStackAt(int32 StackIndex);
+
+	// Flag the inventory for publishing to the owning client
+	UFUNCTION()
+		void MarkInventoryDirty();
+
+	// Tell slot listeners that all slots were replaced
+	void NotifySlotsReset();
+
+	// Publish a new stack order to the state tracker, the journal and slot listeners
+	void NotifyOrderChanged();
+
+	// Count a changed stack in the class and tag totals
+	void UpdateStackAggregates(const FInventoryStruct& Stack);
+
+	// Take a removed stack out of the class and tag totals
+	void RemoveStackAggregates(int32 UniqueID);
+
+	// Catch up with an array that was replaced as a whole, listeners only hear about classes whose total changed
+	void SyncAggregates();
+
+	// Add an amount change of a class to the class and tag totals and tell listeners
+	void ApplyAggregateDelta(UClass* ItemClass, int32 Delta);
+
+	// Add an amount change of a class to the totals of its tags
+	void AddToTagTotals(const UClass* ItemClass, int32 Delta) const;
+
+	// Build the totals if they are not kept yet, and the tag totals again after the database changed
+	void EnsureAggregates() const;
+
+	// Amount of one source stack to move to another inventory
+	struct FTransferEntry
+	{
+		int32 SourceIndex;
+		int32 Amount;
+	};
+
+	// Check that all entries fit into the destination, then move them, nothing changes if any of them does not fit
+	bool TransferEntries(UInventoryComponent* Destination, const TArray<FTransferEntry>& Entries);
+
+	// Hold back class total notifications until the matching EndClassTotalBatch
+	void BeginClassTotalBatch();
+
+	// Tell listeners once about every class whose total changed during the batch
+	void EndClassTotalBatch();
+
+	// The tag totals were built with the current database and version
+	bool AreTagTotalsCurrent() const;
+
+	// Publish every slot that differs from an older copy of the array
+	void PublishSlotDifferences(const TArray<FInventoryStruct>& OldItemArray);
+
+	// Start the cooldown of a class, false if it is still running
+	bool TryStartUseCooldown(TSubclassOf<class AItem> ItemClass);
+
+	// True inside the outermost operation while recording
+	bool IsRecordingOperation() const;
+
+	// Publish the current state of a stack to slot listeners and the journal
+	void JournalStack(int32 StackIndex);
+
+	// Publish the current state of a stack to slot listeners only, for changes the journal gets as one batched record
+	void PublishStack(int32 StackIndex);
+
+	// Write the order of all stacks to the journal
+	void JournalOrder();
+
+	// Write the grid cells of all stacks to the journal as one record
+	void JournalCells();
+
+	// Publish the removal of a stack to slot listeners and the journal
+	void JournalRemoval(int32 UniqueID);
+
+	// Index of a class in the current journal, defines it on first use
+	int32 GetJournalClassIndex(UClass* ItemClass);
+
 	//
 	UFUNCTION()
 		void AddDefaultItem(AItem* InItem);
 
-	//
+	// Amount of an offered stack that fits into the remaining weight capacity
+	UFUNCTION()
+		int32 CalculatePickupAmount(AItem* ItemData, int32 OfferedAmount);
+
+	// Move the given amount of a default item from the scene into the inventory
+	UFUNCTION()
+		int32 PickupDefaultItem(AItem* InItem, int32 PickupAmount);
+
+	// Fill partial stacks of the item class, then add full stacks and one remainder, only reads the item data so class defaults work as well
+	UFUNCTION()
+		int32 AddDefaultStack(AItem* InItem, int32 PickupAmount);
+
+	// Value of a single unit of this item for the pickup planner
+	UFUNCTION()
+		int32 CalculatePickupValue(AItem* InItem, EPickupValueMethod ValueMethod);
+
+	// Put an item into a slot, the previous item of the slot is dropped
+	UFUNCTION()
+		void EquipItem(AItem* InItem, int32 SlotIndex);
+
+	// Equip into the slot named Backpack
 	UFUNCTION()
 		void AddBackpackItem(AItem* InItem);
 
-	//
+	// Equip into the slot named Weapon
 	UFUNCTION()
 		void AddWeaponItem(AItem* InItem);
 
-	//
+	// Equip into the slot named Cosmetic
 	UFUNCTION()
 		void AddCosmeticItem(AItem* InItem);
 
+	// Copy the slots named Backpack, Weapon and Cosmetic into the members of the old fixed slots
+	void SyncNamedEquipment();
+
+	// Size the equipment arrays to the table
+	void InitEquipmentSlots();
+
+	// Capacity an item adds while it is equipped in a slot
+	int32 CalculateEquipmentCapacity(int32 SlotIndex, const FInventoryStruct& Item) const;
+
+	// Publish the item class of a slot to other clients and show it here
+	void SetEquippedVisual(int32 SlotIndex, UClass* ItemClass);
+
+	// Attach the mesh of an item class to the socket of a slot on this machine, null clears the slot
+	void ShowEquippedVisual(int32 SlotIndex, UClass* ItemClass);
+
+	// Item class of a visual id, null if empty or unknown
+	UClass* GetEquippedVisualClass(uint16 VisualId) const;
+
+	// Size the attached meshes to a slot count, meshes of slots that are gone are destroyed
+	void ResizeEquippedMeshes(int32 NumSlots);
+
+	// Equipment of the server changed, update the attached meshes
+	UFUNCTION()
+		void OnRep_EquippedVisuals();
+
 	// Attach the item mesh to socket
 	UFUNCTION()
 		void AttachItemMeshToCharacter(UStaticMesh* ItemMesh, FName AttachSocket, UStaticMeshComponent* MeshSlot);
@@ -239,6 +769,137 @@ private:
 	UFUNCTION()
 		void SortInventoryByPriority();
 
+	// Find a grid position for a stack size using the configured placement
+	UFUNCTION()
+		bool FindGridPosition(int32 Width, int32 Height, int32& OutX, int32& OutY);
+
+	// Find a grid position for a stack and occupy it
+	UFUNCTION()
+		bool PlaceStackInGrid(int32 StackIndex);
+
+	// Remove a stack from the array and free its grid cells
+	UFUNCTION()
+		void RemoveStackAt(int32 StackIndex);
+
+	// Make room for new stacks, the first allocation covers MinStackCapacity at once
+	void ReserveStacks(int32 NumNewStacks);
+
+	// Release stack capacity after large removals
+	void ApplyShrinkPolicy();
+
+	// Place all stacks again in array order, restores the old layout if not everything fits
+	UFUNCTION()
+		bool RepackGrid(bool bLargestFirst);
+
+	// Occupancy of the grid, derived from the stack positions
+	FInventoryGrid Grid;
+
+	// Visual id of the item in every slot, replicated to everyone. 0 is empty, ids with FallbackVisualBit index FallbackVisualClasses, all others are ItemDatabase definitions
+	UPROPERTY(ReplicatedUsing = OnRep_EquippedVisuals)
+		TArray<uint16> EquippedVisuals;
+
+	// Classes shown in a slot without a definition in ItemDatabase, in the order they were first equipped. Every class is only sent once
+	UPROPERTY(ReplicatedUsing = OnRep_EquippedVisuals)
+		TArray<UClass*> FallbackVisualClasses;
+
+	// Marks visual ids that index FallbackVisualClasses
+	static const uint16 FallbackVisualBit = 0x8000;
+
+	// Attached item meshes by slot id
+	UPROPERTY()
+		TArray<UStaticMeshComponent*> EquippedMeshes;
+
+	// Server copy of ItemArray replicated to the owner, never modified by clients
+	UPROPERTY(ReplicatedUsing = OnRep_ServerState)
+		TArray<FInventoryStruct> ServerItemArray;
+
+	// Last command sequence executed by the server
+	UPROPERTY(ReplicatedUsing = OnRep_ServerState)
+		int32 LastProcessedSequence = 0;
+
+	// Last command sequence handed out on the owning client
+	int32 LastSubmittedSequence = 0;
+
+	// Commands predicted locally that the server has not acknowledged yet
+	TArray<FInventoryCommand> PendingCommands;
+
+	// Commands waiting for the next batch to the server
+	TArray<FInventoryCommand> OutgoingCommands;
+
+	// Time since the last batch was sent
+	float TimeSinceCommandFlush = 0.f;
+
+	// ItemArray changed since it was last published to ServerItemArray
+	bool bInventoryDirty = false;
+
+	// ItemArray changed since the last snapshot
+	bool bSnapshotDirty = true;
+
+	// Version of the next snapshot
+	uint32 SnapshotVersion = 0;
+
+	FInventorySnapshotPublisherRef SnapshotPublisher = MakeShareable(new FInventorySnapshotPublisher);
+
+	// Copy-on-write mirror of ItemArray, only active after the first CaptureState
+	FInventoryStateTracker StateTracker;
+
+	// Saved states for UndoLastAction, newest last
+	TArray<FInventoryStateSnapshot> UndoStates;
+
+	// Class and amount of a stack as counted in the totals
+	struct FAggregatedStack
+	{
+		UClass* ItemClass;
+		int32 Amount;
+	};
+
+	// Totals are built on BeginPlay, or by a query before it, from then on every stack change updates them
+	mutable TMap<int32, FAggregatedStack> AggregatedStacks;
+
+	// Items per class
+	mutable TMap<UClass*, int32> ClassTotals;
+
+	// Items per tag bit of the database
+	mutable TArray<int32> TagTotals;
+
+	// Tag bits with at least one item
+	mutable FInventoryTagBits PresentTagBits;
+
+	// Database and version the tag totals were built with, only used while it is still ItemDatabase
+	mutable const UInventoryItemDatabase* AggregatedDatabase = nullptr;
+	mutable uint32 AggregatedDatabaseVersion = 0;
+
+	mutable bool bAggregatesValid = false;
+	mutable bool bTagTotalsValid = false;
+
+	// Nesting depth of class total batches
+	int32 ClassTotalBatchDepth = 0;
+
+	// Classes whose total changed during the current batch
+	TArray<UClass*, TInlineAllocator<4>> BatchedTotalClasses;
+
+	// Handle of the open journal, INDEX_NONE if journaling is off
+	int32 JournalHandle = INDEX_NONE;
+
+	// Records written since the last snapshot
+	int32 JournalRecordsSinceCompaction = 0;
+
+	// Classes already defined in the current journal
+	TMap<UClass*, int32> JournalClassIndices;
+
+	// Writes the operation stream while recording
+	TUniquePtr<FInventoryRecorder> Recorder;
+
+	// Nesting depth of recorded operations
+	int32 OperationDepth = 0;
+
+	// The recorder and replay read and drive the internal state directly
+	friend class FInventoryRecorder;
+	friend class FInventoryReplay;
+
+	// World time at which the cooldown of each class ends
+	TMap<UClass*, float> UseCooldownEndTimes;
+
 	// Counter used to generate unique stack IDs
 	UPROPERTY()
 		int32 UniqueIDCounter = 0;
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "InventoryComponent.h"
+#include "InventoryRecipeBook.h"
+#include "InventoryCraftingEvaluator.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FInventoryCraftableChangedDelegate, int32, RecipeIndex, int32, MaxCrafts);
+
+// Keeps how often every recipe of a book can be crafted from an inventory.
+// Follows the class totals of the inventory and only evaluates the recipes using a class whose total changed.
+UCLASS(BlueprintType)
+class INVENTORYPLUGIN_API UInventoryCraftingEvaluator : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	// Evaluate all recipes of the book against the inventory and follow its changes
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Crafting")
+		void Bind(UInventoryComponent* InInventory, UInventoryRecipeBook* InRecipeBook);
+
+	// How often a recipe can be crafted right now
+	UFUNCTION(BlueprintPure, Category = "Inventory|Crafting")
+		int32 GetMaxCrafts(int32 RecipeIndex) const;
+
+	UFUNCTION(BlueprintPure, Category = "Inventory|Crafting")
+		bool CanCraft(int32 RecipeIndex) const { return GetMaxCrafts(RecipeIndex) > 0; }
+
+	// Indices of all recipes that can be crafted at least once
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Crafting")
+		void GetCraftableRecipes(TArray<int32>& OutRecipeIndices) const;
+
+	UFUNCTION(BlueprintPure, Category = "Inventory|Crafting")
+		int32 GetNumCraftable() const { return NumCraftable; }
+
+	// Recipe evaluations since binding, for profiling
+	UFUNCTION(BlueprintPure, Category = "Inventory|Crafting")
+		int32 GetNumEvaluations() const { return NumEvaluations; }
+
+	// Called when the max craft count of a recipe changed
+	UPROPERTY(BlueprintAssignable, Category = "Inventory|Crafting")
+		FInventoryCraftableChangedDelegate OnCraftableChanged;
+
+	virtual void BeginDestroy() override;
+
+private:
+	// Stop following the bound inventory
+	void Unbind();
+
+	void HandleClassTotalChanged(UClass* ItemClass, int32 NewTotal);
+
+	// Evaluate every recipe again, after binding or when the book was edited
+	void EvaluateAll();
+
+	// Compute the max craft count of one recipe and tell listeners if it changed
+	void EvaluateRecipe(int32 RecipeIndex);
+
+	TWeakObjectPtr<UInventoryComponent> Inventory;
+
+	UPROPERTY()
+		UInventoryRecipeBook* RecipeBook = nullptr;
+
+	// Max craft count of every recipe
+	TArray<int32> MaxCrafts;
+
+	int32 NumCraftable = 0;
+
+	int32 NumEvaluations = 0;
+
+	// Version of the recipe book index MaxCrafts was computed with
+	uint32 RecipeBookVersion = 0;
+
+	FDelegateHandle ClassTotalChangedHandle;
+};
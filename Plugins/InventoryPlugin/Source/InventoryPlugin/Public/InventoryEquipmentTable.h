@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Item.h"
+#include "InventoryEquipmentTable.generated.h"
+
+USTRUCT(BlueprintType)
+struct FInventoryEquipmentSlot
+{
+	GENERATED_BODY()
+
+	// Name the slot is found by
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Equipment")
+		FName SlotName;
+
+	// Socket of the character mesh the item mesh is attached to
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Equipment")
+		FName SocketName;
+
+	// Only items of this type go into the slot
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Equipment")
+		EItemType AcceptedType = EItemType::WEAPON;
+
+	// Add the weight bonus of the equipped item to the inventory capacity
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Equipment")
+		bool bAppliesWeightBonus = false;
+
+	// Added to the inventory capacity while the slot holds an item
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Equipment")
+		int32 CapacityBonus = 0;
+};
+
+// Equipment slots of a character, the slot id is the index in Slots.
+// A picked up item goes into the first slot accepting its type. Inventories without a table use the defaults of this class: backpack, weapon and cosmetic.
+UCLASS(BlueprintType)
+class INVENTORYPLUGIN_API UInventoryEquipmentTable : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// Constructor
+	UInventoryEquipmentTable(const FObjectInitializer& ObjectInitializer);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Equipment")
+		TArray<FInventoryEquipmentSlot> Slots;
+
+	// Slot id of a slot name, INDEX_NONE if there is no such slot
+	int32 FindSlot(FName SlotName) const;
+
+	// First slot accepting an item type, INDEX_NONE if none does
+	int32 FindSlotForType(EItemType ItemType) const;
+
+	// Throw away the lookups, they are rebuilt on next use
+	void InvalidateIndex();
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	// Build the lookups by name and by type
+	void BuildIndex() const;
+
+	mutable TMap<FName, int32> SlotsByName;
+
+	// First slot of every item type, by the value of the type
+	mutable TArray<int32, TInlineAllocator<4>> SlotsByType;
+
+	mutable bool bIndexed = false;
+};
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Occupancy of a spatial inventory grid, stored as one bitmask per row (bit X set = cell occupied)
+class INVENTORYPLUGIN_API FInventoryGrid
+{
+public:
+	// Rows are stored as 64 bit masks
+	static const int32 MaxColumns = 64;
+
+	// Constructor
+	FInventoryGrid();
+
+	// Resize the grid and clear all cells
+	void Init(int32 InColumns, int32 InRows);
+
+	// Clear all cells
+	void Reset();
+
+	int32 GetColumns() const { return Columns; }
+
+	int32 GetRows() const { return Rows; }
+
+	SIZE_T GetAllocatedSize() const { return Occupancy.GetAllocatedSize(); }
+
+	// Check if a rectangle is inside the grid and all its cells are free, O(Height)
+	bool Fits(int32 X, int32 Y, int32 Width, int32 Height) const;
+
+	// Mark the cells of a rectangle as occupied
+	void Occupy(int32 X, int32 Y, int32 Width, int32 Height);
+
+	// Mark the cells of a rectangle as free
+	void Free(int32 X, int32 Y, int32 Width, int32 Height);
+
+	// Find the first free position in reading order (top to bottom, left to right)
+	bool FindFirstFit(int32 Width, int32 Height, int32& OutX, int32& OutY) const;
+
+	// Find the free position that touches the most occupied cells and borders, keeps free space in large blocks
+	bool FindBestFit(int32 Width, int32 Height, int32& OutX, int32& OutY) const;
+
+private:
+	// Bits X to X + Width - 1 set
+	uint64 RowMask(int32 X, int32 Width) const;
+
+	// Bit X set for every X at which a rectangle with its top row at Y fits
+	uint64 FindFitsInRow(int32 Y, int32 Width, int32 Height) const;
+
+	// Number of occupied or out of bounds cells bordering a rectangle
+	int32 CalculateContactScore(int32 X, int32 Y, int32 Width, int32 Height) const;
+
+	int32 Columns;
+
+	int32 Rows;
+
+	// All bits of valid columns set
+	uint64 FullRowMask;
+
+	// One occupancy mask per row
+	TArray<uint64> Occupancy;
+};
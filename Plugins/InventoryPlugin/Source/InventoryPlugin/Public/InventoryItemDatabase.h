@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "GameplayTagContainer.h"
+#include "InventoryItemDatabase.generated.h"
+
+class AItem;
+
+// Gameplay tags of one item class, its index + 1 is the compact id of the class used for replication
+USTRUCT(BlueprintType)
+struct FInventoryItemDefinition
+{
+	GENERATED_BODY()
+
+	// Subclasses without their own definition use this one as well
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Tags")
+		TSubclassOf<AItem> ItemClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Tags")
+		FGameplayTagContainer Tags;
+};
+
+// Tag requirements on a single item, a parent tag also matches items with its child tags
+USTRUCT(BlueprintType)
+struct FInventoryTagQuery
+{
+	GENERATED_BODY()
+
+	// The item needs every one of these
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Tags")
+		FGameplayTagContainer RequireAll;
+
+	// The item needs at least one of these, ignored if empty
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Tags")
+		FGameplayTagContainer RequireAny;
+
+	// The item must have none of these
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Tags")
+		FGameplayTagContainer Exclude;
+};
+
+// Tags as bits, bit i stands for the tag the database compiled to index i
+struct INVENTORYPLUGIN_API FInventoryTagBits
+{
+	TArray<uint32, TInlineAllocator<4>> Words;
+
+	void SetBit(int32 Index);
+
+	void ClearBit(int32 Index);
+
+	bool IsBitSet(int32 Index) const { return Words.IsValidIndex(Index / 32) && (Words[Index / 32] & (1u << (Index % 32))); }
+
+	bool IsEmpty() const;
+
+	// Every bit of Other is set here
+	bool HasAll(const FInventoryTagBits& Other) const;
+
+	// At least one bit of Other is set here
+	bool HasAny(const FInventoryTagBits& Other) const;
+
+	// Call Func with the index of every set bit
+	template <typename FuncType>
+	void ForEachSetBit(FuncType Func) const
+	{
+		for (int32 WordIndex = 0; WordIndex < Words.Num(); WordIndex++)
+		{
+			for (uint32 Word = Words[WordIndex]; Word != 0; Word &= Word - 1)
+			{
+				Func(WordIndex * 32 + (int32)FMath::CountTrailingZeros(Word));
+			}
+		}
+	}
+};
+
+// Query turned into bits of one database version
+struct INVENTORYPLUGIN_API FInventoryCompiledTagQuery
+{
+	FInventoryTagBits All;
+	FInventoryTagBits Any;
+	FInventoryTagBits None;
+
+	// A required tag no definition has
+	bool bNeverMatches = false;
+
+	bool Matches(const FInventoryTagBits& Bits) const
+	{
+		return !bNeverMatches && Bits.HasAll(All) && (Any.IsEmpty() || Bits.HasAny(Any)) && !Bits.HasAny(None);
+	}
+};
+
+// Assigns gameplay tags to item classes and compiles them into one bitset per class, so tag queries are a few word operations.
+// Every tag gets its own bit and every definition also sets the bits of the parents of its tags.
+// Compiled on first use and again after edits or changes of the tag tree, GetVersion tells users when their caches are stale.
+UCLASS(BlueprintType)
+class INVENTORYPLUGIN_API UInventoryItemDatabase : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Tags")
+		TArray<FInventoryItemDefinition> Definitions;
+
+	// Check an item class against a query
+	UFUNCTION(BlueprintPure, Category = "Inventory|Tags")
+		bool ItemClassMatches(TSubclassOf<AItem> ItemClass, const FInventoryTagQuery& Query) const;
+
+	// Bits of an item class, from the closest class with a definition, empty if there is none
+	const FInventoryTagBits& GetClassBits(const UClass* ItemClass) const;
+
+	// Bit of a tag, INDEX_NONE if no definition has the tag
+	int32 GetTagBit(const FGameplayTag& Tag) const;
+
+	// Amount of tag bits of the current version
+	int32 GetNumTagBits() const;
+
+	// Compact id of the definition of exactly this class, 0 if it has none
+	int32 GetDefinitionId(const UClass* ItemClass) const;
+
+	// Item class of a definition id, null for 0 and unknown ids
+	UClass* GetDefinitionClass(int32 DefinitionId) const;
+
+	FInventoryCompiledTagQuery CompileQuery(const FInventoryTagQuery& Query) const;
+
+	// Changes every time the bits are compiled again
+	uint32 GetVersion() const;
+
+	// Throw away the compiled bits, they are rebuilt on the next query
+	void InvalidateCompiledTags();
+
+	virtual void PostInitProperties() override;
+	virtual void BeginDestroy() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	// Assign bits to all tags and their parents, build the class bits and the definition ids
+	void Compile() const;
+
+	// Tag of every bit
+	mutable TArray<FGameplayTag> BitTags;
+
+	mutable TMap<FGameplayTag, int32> TagBits;
+
+	// Bits of classes with a definition, subclasses are added on first lookup
+	mutable TMap<const UClass*, FInventoryTagBits> ClassBits;
+
+	// Definition id of every class with a definition
+	mutable TMap<const UClass*, int32> DefinitionIds;
+
+	mutable uint32 Version = 0;
+
+	mutable bool bCompiled = false;
+
+	FDelegateHandle TagTreeChangedHandle;
+};
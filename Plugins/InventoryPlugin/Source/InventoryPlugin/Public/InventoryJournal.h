@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+
+// Kind of journal record
+enum class EInventoryJournalOp : uint8
+{
+	// Assign a class path to a class index used by the following records
+	DEFINE_CLASS,
+	// Insert or update a stack, written by older versions
+	SET_STACK,
+	// Remove a stack
+	REMOVE_STACK,
+	// Insert or update a stack together with its global ID
+	SET_GLOBAL_STACK,
+	// New order of all stacks
+	ORDER,
+	// New grid cells of a set of stacks
+	SET_CELLS
+};
+
+// One entry of the journal, SET_STACK and REMOVE_STACK are idempotent so replaying a record twice is harmless
+struct FInventoryJournalRecord
+{
+	EInventoryJournalOp Op = EInventoryJournalOp::SET_GLOBAL_STACK;
+
+	int32 UniqueID = -1;
+
+	int64 GlobalID = 0;
+
+	int32 ClassIndex = -1;
+
+	int32 Amount = 0;
+
+	int32 GridX = -1;
+
+	int32 GridY = -1;
+
+	// Only used by DEFINE_CLASS
+	FString ClassPath;
+
+	// Only used by ORDER and SET_CELLS
+	TArray<int32> UniqueIDs;
+
+	// Only used by SET_CELLS, the cell of every stack in UniqueIDs
+	TArray<FIntPoint> Cells;
+
+	friend FArchive& operator<<(FArchive& Ar, FInventoryJournalRecord& Record);
+};
+
+// One stack stored in a snapshot
+struct FInventoryJournalSnapshotEntry
+{
+	int32 UniqueID = -1;
+
+	// Stored after the entries, 0 in snapshots of older versions
+	int64 GlobalID = 0;
+
+	int32 Amount = 0;
+
+	int32 GridX = -1;
+
+	int32 GridY = -1;
+
+	FString ClassPath;
+
+	friend FArchive& operator<<(FArchive& Ar, FInventoryJournalSnapshotEntry& Entry);
+};
+
+// Appends journal records and writes snapshots on a background thread.
+// The game thread only pushes into a lock free queue; the writer drains it and flushes every touched file once per group.
+class INVENTORYPLUGIN_API FInventoryJournalWriter : public FRunnable
+{
+public:
+	// Time the writer waits to collect records before a group flush
+	static const uint32 GroupCommitMilliseconds = 50;
+
+	// Shared writer, the thread is started on first use
+	static FInventoryJournalWriter& Get();
+
+	// Stop the thread and flush everything, called on module shutdown
+	static void Shutdown();
+
+	// Open a journal for appending and return its handle
+	int32 OpenJournal(const FString& Name);
+
+	// Flush and close a journal
+	void CloseJournal(int32 JournalHandle);
+
+	// Queue a record, safe to call from the game thread at any rate
+	void Append(int32 JournalHandle, const FInventoryJournalRecord& Record);
+
+	// Queue a snapshot, all records queued before it are covered and the journal is truncated after writing it
+	void WriteSnapshot(int32 JournalHandle, TArray<FInventoryJournalSnapshotEntry>&& Entries);
+
+	// Load the snapshot and replay the journal tail of a journal name, stops at the first torn or corrupt record. Stacks come back in inventory order
+	static bool Recover(const FString& Name, TArray<FInventoryJournalSnapshotEntry>& OutStacks);
+
+	// File locations of a journal name
+	static FString GetJournalPath(const FString& Name);
+	static FString GetSnapshotPath(const FString& Name);
+
+	// FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	virtual ~FInventoryJournalWriter();
+
+private:
+	FInventoryJournalWriter();
+
+	enum class ETaskType : uint8
+	{
+		OPEN,
+		APPEND,
+		SNAPSHOT,
+		CLOSE
+	};
+
+	struct FTask
+	{
+		ETaskType Type;
+		int32 JournalHandle;
+		FString Name;
+		FInventoryJournalRecord Record;
+		TArray<FInventoryJournalSnapshotEntry> Snapshot;
+	};
+
+	struct FOpenJournal
+	{
+		FString Name;
+		FArchive* Writer = nullptr;
+	};
+
+	// Execute all queued tasks and flush the touched journals
+	void ProcessTasks();
+
+	// Write one framed record (length, payload, crc)
+	void WriteRecord(FOpenJournal& Journal, FInventoryJournalRecord& Record);
+
+	// Write a snapshot next to the journal and restart the journal
+	void WriteSnapshotFile(FOpenJournal& Journal, TArray<FInventoryJournalSnapshotEntry>& Entries);
+
+	TQueue<FTask, EQueueMode::Mpsc> Tasks;
+
+	// Only touched by the writer thread
+	TMap<int32, FOpenJournal> OpenJournals;
+
+	FEvent* WakeEvent;
+
+	FRunnableThread* Thread;
+
+	FThreadSafeCounter NextJournalHandle;
+
+	FThreadSafeBool bStopping;
+
+	// Reused buffer for record payloads
+	TArray<uint8> RecordBuffer;
+
+	static FInventoryJournalWriter* Instance;
+};
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "InventoryLootTable.generated.h"
+
+class AItem;
+class UInventoryLootTable;
+
+USTRUCT(BlueprintType)
+struct FInventoryLootEntry
+{
+	GENERATED_BODY()
+
+	// Item dropped by this entry, leave empty together with NestedTable for a roll that drops nothing
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Loot")
+		TSubclassOf<AItem> ItemClass;
+
+	// Table rolled instead of ItemClass, rolled once per amount
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Loot")
+		UInventoryLootTable* NestedTable = nullptr;
+
+	// Relative chance of this entry
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Loot", meta = (ClampMin = "0"))
+		float Weight = 1.f;
+
+	// Smallest amount dropped
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Loot", meta = (ClampMin = "1"))
+		int32 MinAmount = 1;
+
+	// Largest amount dropped
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Loot", meta = (ClampMin = "1"))
+		int32 MaxAmount = 1;
+};
+
+USTRUCT(BlueprintType)
+struct FInventoryLootDrop
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Loot")
+		TSubclassOf<AItem> ItemClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Loot")
+		int32 Amount = 0;
+};
+
+// Weighted loot entries sampled in O(1) per roll through an alias table.
+// The alias table is built on the first roll and kept on the asset until the entries are edited.
+UCLASS(BlueprintType)
+class INVENTORYPLUGIN_API UInventoryLootTable : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// Deepest chain of nested tables followed, guards against tables containing themselves
+	static const int32 MaxNestingDepth = 8;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Loot")
+		TArray<FInventoryLootEntry> Entries;
+
+	// Roll the table NumRolls times, drops of the same class are merged
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Loot")
+		void RollLoot(const FRandomStream& Stream, int32 NumRolls, TArray<FInventoryLootDrop>& OutDrops) const;
+
+	// Spawn all drops in one pass spread around a point, amounts above the item max amount are split into several items
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Loot", meta = (WorldContext = "WorldContextObject"))
+		static void SpawnLoot(UObject* WorldContextObject, const TArray<FInventoryLootDrop>& Drops, FVector Center, float Radius, TArray<AItem*>& OutItems);
+
+	// Throw away the alias table, it is rebuilt on the next roll
+	void InvalidateCompiledTable();
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	// Build the alias table from the entry weights
+	void Compile() const;
+
+	// Add the results of NumRolls rolls to OutDrops
+	void RollInto(const FRandomStream& Stream, int32 NumRolls, TArray<FInventoryLootDrop>& OutDrops, int32 Depth) const;
+
+	// Chance of keeping the sampled column instead of taking its alias
+	mutable TArray<float> AliasProbabilities;
+
+	mutable TArray<int32> AliasIndices;
+
+	mutable bool bCompiled = false;
+};
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// One item the planner may take units of
+struct FInventoryPickupCandidate
+{
+	// Weight of a single unit
+	int32 Weight = 0;
+
+	// Value of a single unit
+	int32 Value = 0;
+
+	// Maximum amount of units that can be taken
+	int32 MaxAmount = 0;
+
+	FInventoryPickupCandidate() {}
+
+	FInventoryPickupCandidate(int32 InWeight, int32 InValue, int32 InMaxAmount)
+		: Weight(InWeight), Value(InValue), MaxAmount(InMaxAmount)
+	{
+	}
+};
+
+// Chooses how many units of each candidate to take so the total value is maximized without exceeding a weight capacity.
+// Small problems are solved exactly as a bounded knapsack, larger ones fall back to a density greedy with a repair pass.
+class INVENTORYPLUGIN_API FInventoryPickupPlanner
+{
+public:
+	// Upper bound for the exact solver's table (parts * capacity), keeps planning well below a millisecond
+	static const int32 MaxExactTableCells = 64 * 1024;
+
+	// Fill OutAmounts with the amount to take per candidate and return the total value of the plan
+	static int64 Plan(const TArray<FInventoryPickupCandidate>& Candidates, int32 Capacity, TArray<int32>& OutAmounts);
+
+private:
+	// Exact bounded knapsack using binary splitting of amounts
+	static int64 PlanExact(const TArray<FInventoryPickupCandidate>& Candidates, int32 Capacity, TArray<int32>& OutAmounts);
+
+	// Value density greedy followed by single unit exchange repairs
+	static int64 PlanGreedy(const TArray<FInventoryPickupCandidate>& Candidates, int32 Capacity, TArray<int32>& OutAmounts);
+};
@@ -2,6 +2,8 @@
 
 #include "ModuleManager.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogInventory, Log, All);
+
 class FInventoryPluginModule : public IModuleInterface
 {
 public:
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "InventoryRecipeBook.generated.h"
+
+class AItem;
+
+USTRUCT(BlueprintType)
+struct FInventoryRecipeIngredient
+{
+	GENERATED_BODY()
+
+	// Only items of exactly this class count
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Crafting")
+		TSubclassOf<AItem> ItemClass;
+
+	// Amount used by one craft
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Crafting", meta = (ClampMin = "1"))
+		int32 Amount = 1;
+};
+
+USTRUCT(BlueprintType)
+struct FInventoryRecipe
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Crafting")
+		FName RecipeName;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Crafting")
+		TArray<FInventoryRecipeIngredient> Ingredients;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Crafting")
+		TSubclassOf<AItem> ResultClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Crafting", meta = (ClampMin = "1"))
+		int32 ResultAmount = 1;
+};
+
+// Recipes together with an inverted index from ingredient class to the recipes using it.
+// The index is built on first use and kept on the asset until the recipes are edited.
+UCLASS(BlueprintType)
+class INVENTORYPLUGIN_API UInventoryRecipeBook : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Crafting")
+		TArray<FInventoryRecipe> Recipes;
+
+	// Indices of the recipes using a class as ingredient
+	const TArray<int32>& GetRecipesUsing(const UClass* ItemClass) const;
+
+	// Ingredients of a recipe with every class once and the amounts of repeated classes added up
+	const TArray<FInventoryRecipeIngredient>& GetMergedIngredients(int32 RecipeIndex) const;
+
+	// Changes every time the index is built again
+	uint32 GetVersion() const;
+
+	// Throw away the index, it is rebuilt on next use
+	void InvalidateIndex();
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	// Build the merged ingredients and the inverted index
+	void BuildIndex() const;
+
+	mutable TArray<TArray<FInventoryRecipeIngredient>> MergedIngredients;
+
+	mutable TMap<const UClass*, TArray<int32>> RecipesByClass;
+
+	mutable uint32 Version = 0;
+
+	mutable bool bIndexed = false;
+};
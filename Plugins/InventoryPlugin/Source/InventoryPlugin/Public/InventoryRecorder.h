@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UInventoryComponent;
+struct FInventoryStruct;
+
+// Writes the operation stream of one inventory to a text file, one operation per line.
+// The file starts with the inventory state at the time recording started so a replay begins from the same point.
+class INVENTORYPLUGIN_API FInventoryRecorder
+{
+public:
+	static const int32 FormatVersion = 1;
+
+	// Open the file and write the current state of the inventory
+	FInventoryRecorder(const FString& InPath, const UInventoryComponent& Inventory);
+
+	~FInventoryRecorder();
+
+	bool IsOpen() const { return Writer != nullptr; }
+
+	// Append one operation line, preceded by a capacity line if the capacity changed since the last one
+	void Record(const UInventoryComponent& Inventory, const FString& Operation);
+
+	// Default file location of a recording name
+	static FString GetRecordingPath(const FString& Name);
+
+private:
+	void WriteLine(const FString& Line);
+
+	FArchive* Writer;
+
+	int32 RecordedCapacity;
+};
+
+// Loads a recording and re-executes it against an inventory without a world, optionally checked against a reference model
+class INVENTORYPLUGIN_API FInventoryReplay
+{
+public:
+	// Parse a recording and resolve all item classes
+	bool Load(const FString& Path, FString& OutError);
+
+	// Reset the inventory to the state at the start of the recording
+	void ApplyInitialState(UInventoryComponent* Inventory) const;
+
+	// Execute all operations, with bVerify every result is compared to the reference model and the first mismatch is reported
+	bool Run(UInventoryComponent* Inventory, bool bVerify, FString& OutError) const;
+
+	int32 GetNumOperations() const { return Operations.Num(); }
+
+private:
+	enum class EOperation : uint8
+	{
+		CAPACITY,
+		ADD,
+		SPLIT,
+		COMBINE,
+		REMOVE,
+		DROP,
+		SORT,
+		MOVE,
+		REORDER,
+		ARRANGE,
+		CONSUME,
+		TRANSFER
+	};
+
+	struct FOperation
+	{
+		EOperation Type;
+		UClass* ItemClass = nullptr;
+		int32 A = 0;
+		int32 B = 0;
+		int32 C = 0;
+		int32 Line = 0;
+	};
+
+	struct FInitialStack
+	{
+		UClass* ItemClass = nullptr;
+		int32 Amount = 0;
+		int32 UniqueID = -1;
+		int32 GridX = -1;
+		int32 GridY = -1;
+	};
+
+	// Layout of stacks moved in from another inventory, A of a TRANSFER operation is its index in Transfers
+	struct FTransfer
+	{
+		// Destination index and added amount of every merge
+		TArray<FIntPoint> Merges;
+
+		// Stacks appended in this order
+		TArray<FInitialStack> NewStacks;
+	};
+
+	// Stack of a recorded class with everything else from the item defaults
+	static FInventoryStruct MakeStack(const FInitialStack& InitialStack);
+
+	// Execute one operation through the same code paths the game uses
+	void Execute(UInventoryComponent* Inventory, const FOperation& Operation) const;
+
+	TArray<FInitialStack> InitialStacks;
+
+	TArray<FOperation> Operations;
+
+	TArray<FTransfer> Transfers;
+
+	int32 InitialCapacity = 0;
+
+	int32 InitialUniqueIDCounter = 0;
+
+	bool bInitialUseGrid = false;
+
+	int32 InitialGridColumns = 0;
+
+	int32 InitialGridRows = 0;
+
+	uint8 InitialGridPlacement = 0;
+};
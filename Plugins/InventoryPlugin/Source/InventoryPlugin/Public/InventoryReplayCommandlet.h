@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "InventoryReplayCommandlet.generated.h"
+
+// Replays an inventory recording headless at full speed and reports the throughput
+// Usage: UE4Editor-Cmd InventoryProject -run=InventoryReplay -file=<path> [-verify] [-iterations=<n>]
+UCLASS()
+class INVENTORYPLUGIN_API UInventoryReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	// Constructor
+	UInventoryReplayCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+
+struct FInventoryStruct;
+
+// One stack as seen by worker threads, only plain values so nothing needs the game thread
+struct FInventorySnapshotStack
+{
+	// Only compare, never dereference off the game thread
+	const UClass* ItemClass = nullptr;
+
+	int32 ItemAmount = 0;
+	int32 ItemMaxAmount = 0;
+	int32 ItemWeight = 0;
+	int32 UniqueID = -1;
+	int64 GlobalID = 0;
+	int32 SortPriority = 0;
+	int32 GridX = -1;
+	int32 GridY = -1;
+	uint8 ItemType = 0;
+};
+
+// Immutable state of an inventory at one version, safe to read from any thread
+struct INVENTORYPLUGIN_API FInventorySnapshot
+{
+	FInventorySnapshot(uint32 InVersion, const TArray<FInventoryStruct>& Stacks);
+
+	// Amount of items of a class over all stacks
+	int32 GetItemCount(const UClass* ItemClass) const;
+
+	// Increases with every published change of the inventory
+	const uint32 Version;
+
+	// Sum of stack weights
+	int32 TotalWeight = 0;
+
+	TArray<FInventorySnapshotStack> Stacks;
+};
+
+typedef TSharedPtr<const FInventorySnapshot, ESPMode::ThreadSafe> FInventorySnapshotPtr;
+
+// Publishes snapshots RCU style: the game thread swaps in a new snapshot with one atomic exchange, readers on any thread take a reference without locks.
+// Readers count themselves in one of two epochs. Retiring flips the epoch, and the replaced holders are freed once the readers of the old epoch are done,
+// so steady reads never hold back reclaiming. Snapshots themselves live as long as any reader still holds them.
+class INVENTORYPLUGIN_API FInventorySnapshotPublisher
+{
+public:
+	~FInventorySnapshotPublisher();
+
+	// Latest snapshot, any thread, null before the first publish
+	FInventorySnapshotPtr Read() const;
+
+	// Replace the latest snapshot, game thread only
+	void Publish(const FInventorySnapshotPtr& Snapshot);
+
+	// Free replaced holders no reader can still see and start the grace period of the ones retired since, game thread only
+	void ReclaimRetired();
+
+	// Version of the latest snapshot, 0 before the first publish, game thread only
+	uint32 GetPublishedVersion() const { return PublishedVersion; }
+
+	// Hammer Read from worker threads while publishing, for race detectors like ThreadSanitizer, returns false on an inconsistent read
+	static bool RunStressTest(int32 NumReaders, float Seconds);
+
+private:
+	struct FHolder
+	{
+		FInventorySnapshotPtr Snapshot;
+	};
+
+	FHolder* volatile Current = nullptr;
+
+	// Epoch new readers count themselves in, 0 or 1
+	volatile int32 ReaderEpoch = 0;
+
+	// Readers between loading Current and copying its snapshot pointer, by epoch
+	mutable FThreadSafeCounter ActiveReaders[2];
+
+	// Holders replaced since the last epoch flip
+	TArray<FHolder*> Retired;
+
+	// Holders replaced before the last epoch flip, freed once no reader of the old epoch is left
+	TArray<FHolder*> Draining;
+
+	uint32 PublishedVersion = 0;
+};
+
+typedef TSharedRef<FInventorySnapshotPublisher, ESPMode::ThreadSafe> FInventorySnapshotPublisherRef;
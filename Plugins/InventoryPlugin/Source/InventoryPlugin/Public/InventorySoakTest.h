@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "InventorySoakTest.generated.h"
+
+class AItem;
+class ACharacter;
+class UInventoryComponent;
+class FArchive;
+
+// Parameters of one soak run
+struct INVENTORYPLUGIN_API FInventorySoakSettings
+{
+	// Characters acting on their inventories
+	int32 NumBots = 50;
+
+	// World items kept lying around for pickups
+	int32 NumItems = 500;
+
+	// Length of the run in seconds
+	float Seconds = 120.f;
+
+	// Actions every bot tries per second
+	float ActionsPerSecond = 4.f;
+
+	// Bots and items are placed within this distance of the first player start
+	float Radius = 3000.f;
+
+	int32 Seed = 1;
+
+	// Empty writes to Saved/Profiling/InventorySoak_<time>.csv
+	FString CsvPath;
+
+	// Needs a skeletal mesh for the item sockets, gets an inventory component if it has none
+	TSubclassOf<ACharacter> BotClass;
+
+	// Empty uses the classes of the items in the level
+	TArray<TSubclassOf<AItem>> ItemClasses;
+
+	// Quit the game once the run is over
+	bool bExitWhenDone = false;
+
+	// Read -SoakBots= -SoakItems= -SoakSeconds= -SoakRate= -SoakRadius= -SoakSeed= -SoakCsv= -SoakItemClasses=
+	static FInventorySoakSettings FromCommandLine();
+};
+
+// Drives scripted bots that pick up, drop, use, equip, split and sort items for a fixed time and writes one CSV row per frame.
+// Meant for headless runs with -game -nullrhi, see Start. Rows hold frame, game thread and GC time, actor count and the inventory counters of the frame.
+UCLASS(NotPlaceable, Transient)
+class INVENTORYPLUGIN_API AInventorySoakTest : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	// Constructor
+	AInventorySoakTest(const FObjectInitializer& ObjectInitializer);
+
+	// Spawn the bots and items of a run into a world, null if a run is already going
+	static AInventorySoakTest* Start(UWorld* World, const FInventorySoakSettings& InSettings);
+
+	// Run the bot actions of this frame and write the row of the last frame
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	// Called when the game ends or the soak is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// Counters of one frame, also summed up over the whole run
+	struct FSoakCounters
+	{
+		int32 Pickups = 0;
+		int32 Equips = 0;
+		int32 Drops = 0;
+		int32 Uses = 0;
+		int32 Splits = 0;
+		int32 Sorts = 0;
+
+		// Actions without a valid target, like dropping from an empty inventory
+		int32 Skipped = 0;
+
+		FSoakCounters& operator+=(const FSoakCounters& Other);
+	};
+
+	// Spawn the bots, open the CSV and start the clock
+	void BeginRun();
+
+	// Close the CSV, log the summary and quit if wanted
+	void FinishRun();
+
+	// One random action of one bot
+	void RunBotAction(ACharacter* Bot, UInventoryComponent* Inventory);
+
+	void PickupItem(ACharacter* Bot, UInventoryComponent* Inventory);
+
+	// Spawn items until the level holds NumItems again
+	void ReplenishItems();
+
+	// Random location on the soak area
+	FVector GetRandomLocation();
+
+	// Append the row of the frame that just ended
+	void WriteFrameRow(float DeltaSeconds);
+
+	void WriteLine(const FString& Line);
+
+	// Items dropped by the bots become pickups for the others
+	void HandleActorSpawned(AActor* Actor);
+
+	void HandlePreGarbageCollect();
+
+	void HandlePostGarbageCollect();
+
+	// The run going on in a world
+	static TMap<TWeakObjectPtr<UWorld>, TWeakObjectPtr<AInventorySoakTest>> WorldSoakTests;
+
+	FInventorySoakSettings Settings;
+
+	FRandomStream Random;
+
+	FVector Center = FVector::ZeroVector;
+
+	UPROPERTY()
+		TArray<ACharacter*> Bots;
+
+	UPROPERTY()
+		TArray<UInventoryComponent*> Inventories;
+
+	// Items the bots can pick up, destroyed ones are removed when drawn
+	TArray<TWeakObjectPtr<AItem>> WorldItems;
+
+	FArchive* CsvWriter = nullptr;
+
+	FSoakCounters FrameCounters;
+
+	FSoakCounters TotalCounters;
+
+	// Frame times of the whole run for the percentiles of the summary
+	TArray<float> FrameTimes;
+
+	double StartTime = 0.0;
+
+	double GCStartTime = 0.0;
+
+	// Garbage collection time since the last row
+	double FrameGCSeconds = 0.0;
+
+	double TotalGCSeconds = 0.0;
+
+	// Inventory memory is sampled once per second, the rows in between repeat it
+	double NextMemorySampleTime = 0.0;
+
+	float InventoryKilobytes = 0.f;
+
+	int32 NumFrames = 0;
+
+	bool bRunning = false;
+
+	// Only spawns during bot actions are tracked as world items
+	bool bTrackSpawns = false;
+
+	FDelegateHandle ActorSpawnedHandle;
+
+	FDelegateHandle PreGarbageCollectHandle;
+
+	FDelegateHandle PostGarbageCollectHandle;
+};
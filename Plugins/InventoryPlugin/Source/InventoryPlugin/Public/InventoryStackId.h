@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Hands out globally unique, positive 64 bit stack IDs made of a 15 bit shard prefix, a 32 bit block and a 16 bit sequence.
+// Every thread takes a whole block with one atomic increment and numbers the IDs inside it without any synchronization.
+// Blocks are reserved in bulk against a high water mark saved per shard, so a restarted server never hands out a block twice.
+class INVENTORYPLUGIN_API FInventoryStackIdGenerator
+{
+public:
+	static const int32 SequenceBits = 16;
+	static const int32 BlockBits = 32;
+
+	// Highest shard, one bit less than the prefix has so IDs are never negative
+	static const int32 MaxShard = 0x7FFF;
+
+	// Blocks reserved with one write of the high water mark
+	static const int64 BlocksPerReservation = 1024;
+
+	// Next ID, any thread, lock free, never 0
+	static int64 Generate();
+
+	// Shard prefix of this process, set with -InventoryShard=<0-32767>, 0 by default
+	static int32 GetShard();
+
+	// Shard prefix an ID was generated on
+	static int32 GetShardOfID(int64 ID) { return (int32)(((uint64)ID) >> (BlockBits + SequenceBits)); }
+
+	// Generate IDs on several threads for a while and check they are unique, logs the rate
+	static bool RunStressTest(int32 NumThreads, float Seconds);
+
+private:
+	// Reserve a new block for the calling thread
+	static uint32 AcquireBlock();
+};
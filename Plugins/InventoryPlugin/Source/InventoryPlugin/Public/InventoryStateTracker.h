@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FInventoryStruct;
+struct FInventoryStateSlot;
+
+// Shared table of shared chunks of stacks, defined in the source file
+struct FInventoryStateChunkTable;
+
+// Inventory state at one point in time, copying it is O(1)
+struct INVENTORYPLUGIN_API FInventoryStateSnapshot
+{
+	bool IsValid() const { return Table.IsValid(); }
+
+private:
+	friend class FInventoryStateTracker;
+
+	TSharedPtr<const FInventoryStateChunkTable> Table;
+};
+
+// Mirrors ItemArray into copy-on-write chunks so snapshots are O(1) and each change copies at most one chunk
+class INVENTORYPLUGIN_API FInventoryStateTracker
+{
+public:
+	// False until the first Reset, the component only starts tracking once a snapshot is taken
+	bool IsActive() const { return Table.IsValid(); }
+
+	// Start over from the given stacks
+	void Reset(const TArray<FInventoryStruct>& Stacks);
+
+	// Catch up with an array that was replaced as a whole, only chunks of changed stacks are copied
+	void Sync(const TArray<FInventoryStruct>& Stacks);
+
+	// Add or change a stack, new stacks go to the end of the order
+	void SetStack(const FInventoryStruct& Stack);
+
+	void RemoveStack(int32 UniqueID);
+
+	// Take the order of all stacks from the array after sorting or reordering
+	void SetOrder(const TArray<FInventoryStruct>& Stacks);
+
+	// Share the current state, O(1)
+	FInventoryStateSnapshot Capture() const;
+
+	// Return to a snapshot and write its stacks in order to OutStacks
+	void Restore(const FInventoryStateSnapshot& Snapshot, TArray<FInventoryStruct>& OutStacks);
+
+	// Memory of the current table and its chunks, chunks shared with snapshots included
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	// Slot ready for writing, copies the table and chunk first if a snapshot shares them
+	FInventoryStateSlot& GetMutableSlot(int32 SlotIndex);
+
+	// Rebuild the lookups from the table
+	void RebuildLookups();
+
+	TSharedPtr<FInventoryStateChunkTable> Table;
+
+	// Slot of each stack ID
+	TMap<int32, int32> SlotIndices;
+
+	TArray<int32> FreeSlots;
+
+	int32 NumSlots = 0;
+
+	int64 NextOrderKey = 0;
+};
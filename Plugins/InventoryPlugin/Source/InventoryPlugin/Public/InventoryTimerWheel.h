@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Hierarchical timer wheel with 4 levels of 64 slots (2^24 ticks range).
+// Scheduling is O(1) and advancing a tick only touches one slot, so thousands of pending timers cost next to nothing per frame.
+// Timers further out than the range are parked in the top level and re-inserted until they fit.
+template<typename PayloadType>
+class TInventoryTimerWheel
+{
+public:
+	static const int32 SlotBits = 6;
+	static const int32 SlotsPerLevel = 1 << SlotBits;
+	static const int32 NumLevels = 4;
+
+	TInventoryTimerWheel()
+	{
+		for (int32 Level = 0; Level < NumLevels; Level++)
+		{
+			for (int32 Slot = 0; Slot < SlotsPerLevel; Slot++)
+			{
+				Slots[Level][Slot] = INDEX_NONE;
+			}
+		}
+	}
+
+	uint64 GetCurrentTick() const { return CurrentTick; }
+
+	// Amount of pending timers
+	int32 Num() const { return NumPending; }
+
+	// Fire the payload after DelayTicks ticks, at least one
+	void Schedule(uint64 DelayTicks, const PayloadType& Payload)
+	{
+		int32 EntryIndex = FreeList;
+		if (EntryIndex != INDEX_NONE)
+		{
+			FreeList = Entries[EntryIndex].Next;
+			Entries[EntryIndex].Payload = Payload;
+		}
+		else
+		{
+			EntryIndex = Entries.Add(FEntry(Payload));
+		}
+
+		Entries[EntryIndex].ExpiryTick = CurrentTick + FMath::Max<uint64>(DelayTicks, 1);
+		Insert(EntryIndex);
+		NumPending++;
+	}
+
+	// Move time forward and call OnExpired(Payload) for every timer that expires, in expiry order
+	template<typename FuncType>
+	void Advance(uint64 Ticks, FuncType&& OnExpired)
+	{
+		for (uint64 Step = 0; Step < Ticks; Step++)
+		{
+			CurrentTick++;
+
+			// Higher levels move their timers down whenever the level below wraps around
+			for (int32 Level = 1; Level < NumLevels; Level++)
+			{
+				if ((CurrentTick & ((1ull << (Level * SlotBits)) - 1)) != 0)
+					break;
+
+				Cascade(Level, (CurrentTick >> (Level * SlotBits)) & (SlotsPerLevel - 1));
+			}
+
+			// Detach the slot first, callbacks may schedule new timers
+			const int32 Slot = CurrentTick & (SlotsPerLevel - 1);
+			int32 EntryIndex = Slots[0][Slot];
+			Slots[0][Slot] = INDEX_NONE;
+
+			while (EntryIndex != INDEX_NONE)
+			{
+				const int32 NextIndex = Entries[EntryIndex].Next;
+				PayloadType Payload = MoveTemp(Entries[EntryIndex].Payload);
+
+				Entries[EntryIndex].Payload = PayloadType();
+				Entries[EntryIndex].Next = FreeList;
+				FreeList = EntryIndex;
+				NumPending--;
+
+				OnExpired(Payload);
+				EntryIndex = NextIndex;
+			}
+		}
+	}
+
+private:
+	struct FEntry
+	{
+		uint64 ExpiryTick = 0;
+		int32 Next = INDEX_NONE;
+		PayloadType Payload;
+
+		FEntry(const PayloadType& InPayload) : Payload(InPayload) {}
+	};
+
+	// Put an entry into the lowest level whose slots can still tell its expiry apart from the current tick
+	void Insert(int32 EntryIndex)
+	{
+		FEntry& Entry = Entries[EntryIndex];
+
+		for (int32 Level = 0; Level < NumLevels; Level++)
+		{
+			const int32 Shift = Level * SlotBits;
+			if ((Entry.ExpiryTick >> Shift) - (CurrentTick >> Shift) < SlotsPerLevel)
+			{
+				const int32 Slot = (Entry.ExpiryTick >> Shift) & (SlotsPerLevel - 1);
+				Entry.Next = Slots[Level][Slot];
+				Slots[Level][Slot] = EntryIndex;
+
+				return;
+			}
+		}
+
+		// Beyond the range, park it in the last top level slot and re-insert when that slot cascades
+		const int32 Shift = (NumLevels - 1) * SlotBits;
+		const int32 Slot = ((CurrentTick >> Shift) + SlotsPerLevel - 1) & (SlotsPerLevel - 1);
+		Entry.Next = Slots[NumLevels - 1][Slot];
+		Slots[NumLevels - 1][Slot] = EntryIndex;
+	}
+
+	// Re-insert all entries of a slot, they land in lower levels
+	void Cascade(int32 Level, int32 Slot)
+	{
+		int32 EntryIndex = Slots[Level][Slot];
+		Slots[Level][Slot] = INDEX_NONE;
+
+		while (EntryIndex != INDEX_NONE)
+		{
+			const int32 NextIndex = Entries[EntryIndex].Next;
+			Insert(EntryIndex);
+			EntryIndex = NextIndex;
+		}
+	}
+
+	TArray<FEntry> Entries;
+
+	// Head entry of each slot
+	int32 Slots[NumLevels][SlotsPerLevel];
+
+	int32 FreeList = INDEX_NONE;
+
+	int32 NumPending = 0;
+
+	uint64 CurrentTick = 0;
+};
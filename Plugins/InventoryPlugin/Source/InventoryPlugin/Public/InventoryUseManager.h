@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "InventoryTimerWheel.h"
+#include "InventoryUseManager.generated.h"
+
+class AItem;
+class UInventoryComponent;
+
+// Runs item use effects of one world in a batch once per frame and drives use cooldowns and durations with a single timer wheel.
+// Spawned on demand by Get, one per world, never replicated.
+UCLASS(NotPlaceable, Transient)
+class INVENTORYPLUGIN_API AInventoryUseManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	// Constructor
+	AInventoryUseManager(const FObjectInitializer& ObjectInitializer);
+
+	// Find or spawn the manager of a world
+	static AInventoryUseManager* Get(UWorld* World);
+
+	// Queue one use of an item, OnUse runs with the next batch
+	void EnqueueUse(UInventoryComponent* Inventory, TSubclassOf<AItem> ItemClass);
+
+	// Notify the inventory when its cooldown of this class is over
+	void StartCooldown(UInventoryComponent* Inventory, TSubclassOf<AItem> ItemClass, float Seconds);
+
+	// Length of one timer wheel tick in seconds
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|Use", meta = (ClampMin = "0.001"))
+		float TimerResolution = 1.f / 30.f;
+
+	// Run the queued uses and advance the timer wheel
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	// Called when the game ends or the manager is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	struct FPendingUse
+	{
+		// Its owner becomes the owner of the temp item
+		TWeakObjectPtr<UInventoryComponent> Inventory;
+		TSubclassOf<AItem> ItemClass;
+	};
+
+	struct FUseTimer
+	{
+		// Cooldown end of Inventory and ItemClass, or duration end of Item
+		TWeakObjectPtr<UInventoryComponent> Inventory;
+		TSubclassOf<AItem> ItemClass;
+		TWeakObjectPtr<AItem> Item;
+	};
+
+	// Execute all uses queued since the last batch
+	void RunPendingUses();
+
+	// Amount of wheel ticks covering a duration in seconds
+	uint64 SecondsToTicks(float Seconds) const;
+
+	// Called by the timer wheel
+	void OnTimerExpired(const FUseTimer& Timer);
+
+	TArray<FPendingUse> PendingUses;
+
+	TInventoryTimerWheel<FUseTimer> TimerWheel;
+
+	// Time not yet consumed by a wheel tick
+	float TimerAccumulator = 0.f;
+
+	// Items whose use duration is still running
+	UPROPERTY()
+		TArray<AItem*> ActiveUseItems;
+
+	static TMap<TWeakObjectPtr<UWorld>, TWeakObjectPtr<AInventoryUseManager>> WorldManagers;
+};
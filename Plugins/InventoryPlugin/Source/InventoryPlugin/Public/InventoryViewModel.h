@@ -0,0 +1,202 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "InventoryComponent.h"
+#include "InventoryViewModel.generated.h"
+
+// Stable UI object of one slot, reused while the slot is visible and recycled afterwards
+UCLASS(BlueprintType)
+class INVENTORYPLUGIN_API UInventoryViewEntry : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	// Current state of the slot
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory|View")
+		FInventoryStruct Stack;
+};
+
+// A slot that changed its position in the view
+USTRUCT(BlueprintType)
+struct FInventoryViewMove
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory|View")
+		int32 UniqueID = -1;
+
+	// View index after the change
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory|View")
+		int32 ToIndex = -1;
+};
+
+// Changes of the view since the last notification, by slot ID
+USTRUCT(BlueprintType)
+struct FInventoryViewDiff
+{
+	GENERATED_BODY()
+
+	// The whole view changed, fetch everything again
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory|View")
+		bool bReset = false;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory|View")
+		TArray<int32> Removed;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory|View")
+		TArray<int32> Inserted;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory|View")
+		TArray<int32> Updated;
+
+	// Only the slots that have to move, everything else keeps its relative order
+	UPROPERTY(BlueprintReadOnly, Category = "Inventory|View")
+		TArray<FInventoryViewMove> Moved;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FInventoryViewChangedDelegate, const FInventoryViewDiff&, Diff);
+
+// Filtered and sorted view of an inventory for list widgets.
+// Slot changes update the view in O(log n) each, entry objects are only created for the window the list asks for.
+// Changes are collected and sent once per frame through OnViewChanged.
+UCLASS(BlueprintType)
+class INVENTORYPLUGIN_API UInventoryViewModel : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// Show the slots of an inventory and follow its changes
+	UFUNCTION(BlueprintCallable, Category = "Inventory|View")
+		void Bind(UInventoryComponent* InInventory);
+
+	// Only show slots whose name contains NameFilter, and with bFilterByType only slots of that type
+	UFUNCTION(BlueprintCallable, Category = "Inventory|View")
+		void SetFilter(const FString& NameFilter, bool bFilterByType, EItemType Type);
+
+	// Sort the view, unsorted views keep the order of the inventory
+	UFUNCTION(BlueprintCallable, Category = "Inventory|View")
+		void SetSortMethod(ESortMethod InSortMethod, bool bInSorted);
+
+	// Amount of slots in the view
+	UFUNCTION(BlueprintPure, Category = "Inventory|View")
+		int32 GetNumEntries() const { return View.Num(); }
+
+	// Entry object of a view index, created on first access
+	UFUNCTION(BlueprintCallable, Category = "Inventory|View")
+		UInventoryViewEntry* GetEntry(int32 ViewIndex);
+
+	// Entry objects of a window of the view, entries outside the window are recycled
+	UFUNCTION(BlueprintCallable, Category = "Inventory|View")
+		void GetEntryWindow(int32 FirstIndex, int32 Count, TArray<UInventoryViewEntry*>& OutEntries);
+
+	// View index of a slot, -1 if it is filtered out
+	UFUNCTION(BlueprintPure, Category = "Inventory|View")
+		int32 FindViewIndex(int32 UniqueID) const;
+
+	// Called once per frame with all changes of that frame
+	UPROPERTY(BlueprintAssignable, Category = "Inventory|View")
+		FInventoryViewChangedDelegate OnViewChanged;
+
+	virtual void BeginDestroy() override;
+
+	// Send the collected changes
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return bDiffPending; }
+	virtual bool IsTickableWhenPaused() const override { return true; }
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UInventoryViewModel, STATGROUP_Tickables); }
+
+private:
+	struct FViewSlot
+	{
+		FInventoryStruct Stack;
+
+		// Display name, converted once for sorting and filtering
+		FString Name;
+
+		// Position in the inventory, slots added later go to the end like in ItemArray
+		int32 Order = 0;
+
+		bool bVisible = false;
+	};
+
+	// Stop following the bound inventory
+	void Unbind();
+
+	bool PassesFilter(const FViewSlot& Slot) const;
+
+	// Order of two slots in the view, inventory positions break ties so the order is total
+	bool IsBefore(const FViewSlot& One, int32 OneID, const FViewSlot& Two, int32 TwoID) const;
+
+	// First view index not before the slot
+	int32 FindInsertIndex(const FViewSlot& Slot, int32 UniqueID) const;
+
+	void HandleSlotChanged(const FInventoryStruct& Stack);
+
+	void HandleSlotRemoved(int32 UniqueID);
+
+	// Read all slots again
+	void HandleSlotsReset();
+
+	// Take over the new inventory positions and only move the slots that have to
+	void HandleSlotsReordered();
+
+	// Re-sort the view and mark the fewest slots as moved that bring the old order into the new one
+	void RebuildViewWithMoves();
+
+	// Recompute filter results and order of all slots
+	void RebuildView();
+
+	// Give the entry of a slot back to the pool
+	void ReleaseEntry(int32 UniqueID);
+
+	void MarkInserted(int32 UniqueID);
+
+	void MarkRemoved(int32 UniqueID);
+
+	void MarkUpdated(int32 UniqueID, bool bMoved);
+
+	void MarkReset();
+
+	TWeakObjectPtr<UInventoryComponent> Inventory;
+
+	TMap<int32, FViewSlot> Slots;
+
+	// Order of the next slot added
+	int32 NextOrder = 0;
+
+	// Slot IDs in view order
+	TArray<int32> View;
+
+	// Entries handed out, by slot ID
+	UPROPERTY()
+		TMap<int32, UInventoryViewEntry*> LiveEntries;
+
+	UPROPERTY()
+		TArray<UInventoryViewEntry*> EntryPool;
+
+	FString NameFilter;
+
+	bool bFilterByType = false;
+
+	EItemType FilterType = EItemType::DEFAULT;
+
+	ESortMethod SortMethod = ESortMethod::NAME;
+
+	bool bSorted = false;
+
+	// Changes collected since the last notification
+	TSet<int32> PendingRemoved;
+	TSet<int32> PendingInserted;
+	TSet<int32> PendingUpdated;
+	TSet<int32> PendingMoved;
+	bool bPendingReset = false;
+	bool bDiffPending = false;
+
+	FDelegateHandle SlotChangedHandle;
+	FDelegateHandle SlotRemovedHandle;
+	FDelegateHandle SlotsResetHandle;
+	FDelegateHandle SlotsReorderedHandle;
+};
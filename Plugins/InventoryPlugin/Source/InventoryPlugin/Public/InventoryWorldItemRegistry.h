@@ -0,0 +1,133 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "InventoryWorldItemRegistry.generated.h"
+
+class AItem;
+class UHierarchicalInstancedStaticMeshComponent;
+
+// Holds items lying in the world as plain records drawn by one instanced mesh per item class.
+// A record becomes a real AItem once a pawn comes within PromotionRadius, and turns back into a record when all pawns left DemotionRadius.
+// Spawned on demand by Get, one per world. Records are not replicated, clients only see promoted items.
+UCLASS(NotPlaceable, Transient)
+class INVENTORYPLUGIN_API AInventoryWorldItemRegistry : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Constructor
+	AInventoryWorldItemRegistry(const FObjectInitializer& ObjectInitializer);
+
+	// Find or spawn the registry of a world
+	static AInventoryWorldItemRegistry* Get(UWorld* World);
+
+	// Store an item as record, returns its handle
+	UFUNCTION(BlueprintCallable, Category = "Inventory|WorldItems")
+		int32 AddWorldItem(TSubclassOf<AItem> ItemClass, int32 Amount, const FTransform& Transform);
+
+	// Remove a record without spawning anything
+	UFUNCTION(BlueprintCallable, Category = "Inventory|WorldItems")
+		bool RemoveWorldItem(int32 Handle);
+
+	// Replace a record by a real item actor
+	UFUNCTION(BlueprintCallable, Category = "Inventory|WorldItems")
+		AItem* PromoteWorldItem(int32 Handle);
+
+	// Replace an item actor by a record, returns its handle
+	UFUNCTION(BlueprintCallable, Category = "Inventory|WorldItems")
+		int32 DemoteItem(AItem* Item);
+
+	// Amount of items stored as records
+	UFUNCTION(BlueprintPure, Category = "Inventory|WorldItems")
+		int32 GetNumWorldItems() const { return Records.Num(); }
+
+	// Amount of records currently promoted to actors
+	UFUNCTION(BlueprintPure, Category = "Inventory|WorldItems")
+		int32 GetNumPromotedItems() const { return PromotedItems.Num(); }
+
+	// Bytes allocated for records, spatial cells and instance lookups
+	SIZE_T GetAllocatedSize() const;
+
+	// Log record, instance and actor counts
+	void LogStats() const;
+
+	// Distance at which a pawn turns records into actors
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|WorldItems", meta = (ClampMin = "1"))
+		float PromotionRadius = 500.f;
+
+	// Distance all pawns must be away before a promoted actor turns back into a record
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|WorldItems", meta = (ClampMin = "1"))
+		float DemotionRadius = 800.f;
+
+	// Seconds between two proximity checks
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory|WorldItems", meta = (ClampMin = "0"))
+		float UpdateInterval = 0.25f;
+
+	// Check all pawns against nearby records and promoted actors
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	// Called when the game ends or the registry is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	struct FWorldItemRecord
+	{
+		UClass* ItemClass;
+		int32 Amount;
+		FTransform Transform;
+
+		// Instance in the mesh of its class
+		int32 InstanceIndex;
+
+		FIntPoint Cell;
+	};
+
+	// Instanced mesh of one item class and the record drawn by each instance
+	struct FClassInstances
+	{
+		UHierarchicalInstancedStaticMeshComponent* Mesh = nullptr;
+		TArray<int32> InstanceRecords;
+	};
+
+	// Cell of the spatial hash containing a location
+	FIntPoint GetCell(const FVector& Location) const;
+
+	// Create the instanced mesh of a class from its default item mesh
+	FClassInstances& FindOrAddInstances(UClass* ItemClass);
+
+	// Remove the instance of a record, the last instance of its class takes its place
+	void RemoveRecordInstance(int32 Handle);
+
+	// Remove a record from its spatial cell
+	void RemoveRecordFromCell(int32 Handle);
+
+	// Promote all records within PromotionRadius of a location
+	void PromoteRecordsNear(const FVector& Location);
+
+	// Demote promoted actors no pawn is close to anymore
+	void DemoteDistantItems(const TArray<FVector>& PawnLocations);
+
+	TSparseArray<FWorldItemRecord> Records;
+
+	// Record handles per spatial cell, cells are PromotionRadius wide
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	TMap<UClass*, FClassInstances> ClassInstances;
+
+	// Keeps the instanced meshes alive
+	UPROPERTY()
+		TArray<UHierarchicalInstancedStaticMeshComponent*> InstanceMeshes;
+
+	TArray<TWeakObjectPtr<AItem>> PromotedItems;
+
+	// Cell size the spatial hash was built with
+	float CellSize = 0.f;
+
+	float TimeSinceUpdate = 0.f;
+
+	static TMap<TWeakObjectPtr<UWorld>, TWeakObjectPtr<AInventoryWorldItemRegistry>> WorldRegistries;
+};
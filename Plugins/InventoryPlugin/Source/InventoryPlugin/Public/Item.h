@@ -28,6 +28,10 @@ public:
 	UFUNCTION(BlueprintNativeEvent, Category = "Inventory|Item")
 		void OnUse();
 
+	// Called when the use duration of this item is over
+	UFUNCTION(BlueprintNativeEvent, Category = "Inventory|Item")
+		void OnUseFinished();
+
 	// Thumbnail used in UI for this item
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Inventory|Item")
 		UTexture2D* ItemThumbnail;
@@ -56,10 +60,26 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Inventory|Item")
 		int32 ItemWeight = 0;
 
+	// Width of this item in grid inventory cells
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Inventory|Item", meta = (ClampMin = "1"))
+		int32 ItemGridWidth = 1;
+
+	// Height of this item in grid inventory cells
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Inventory|Item", meta = (ClampMin = "1"))
+		int32 ItemGridHeight = 1;
+
 	// Weight bonus applied when carrying this item
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Inventory|Item")
 		int32 WeightBonus = 0;
 
+	// Seconds before another item of this class can be used from the same inventory
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Inventory|Item", meta = (ClampMin = "0"))
+		float UseCooldown = 0.f;
+
+	// Seconds the use effect lasts, OnUseFinished is called at the end
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Inventory|Item", meta = (ClampMin = "0"))
+		float UseDuration = 0.f;
+
 	// Sort priority (highest numerical priority = first item in list)
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Inventory|Item")
 		int32 SortPriority = 0;
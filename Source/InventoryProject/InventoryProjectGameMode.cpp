@@ -3,6 +3,8 @@
 #include "InventoryProject.h"
 #include "InventoryProjectGameMode.h"
 #include "InventoryProjectCharacter.h"
+#include "InventorySoakTest.h"
+#include "Item.h"
 
 AInventoryProjectGameMode::AInventoryProjectGameMode()
 {
@@ -13,3 +15,37 @@ AInventoryProjectGameMode::AInventoryProjectGameMode()
 		DefaultPawnClass = PlayerPawnBPClass.Class;
 	}
 }
+
+void AInventoryProjectGameMode::StartPlay()
+{
+	Super::StartPlay();
+
+	// Headless soak, e.g. InventoryProject -game -nullrhi -InventorySoak -SoakBots=100 -SoakSeconds=600
+	if (!FParse::Param(FCommandLine::Get(), TEXT("InventorySoak")))
+		return;
+
+	FInventorySoakSettings Settings = FInventorySoakSettings::FromCommandLine();
+	Settings.BotClass = DefaultPawnClass.Get();
+	Settings.bExitWhenDone = true;
+
+	// The example items, whatever the map has placed by now
+	if (Settings.ItemClasses.Num() == 0)
+	{
+		const TCHAR* ItemNames[] = { TEXT("Apple"), TEXT("CowboyHat"), TEXT("LargeBackpack"), TEXT("Medkit"), TEXT("Shotgun"),
+			TEXT("ShotgunAmmo"), TEXT("SmallBackpack"), TEXT("StrawHat"), TEXT("TopHat") };
+
+		for (const TCHAR* ItemName : ItemNames)
+		{
+			const FString ItemClassPath = FString::Printf(TEXT("/Game/Blueprints/Items/%s.%s_C"), ItemName, ItemName);
+			if (UClass* ItemClass = StaticLoadClass(AItem::StaticClass(), nullptr, *ItemClassPath))
+			{
+				Settings.ItemClasses.Add(ItemClass);
+			}
+		}
+	}
+
+	if (!AInventorySoakTest::Start(GetWorld(), Settings))
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
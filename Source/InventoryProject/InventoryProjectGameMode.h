@@ -10,6 +10,9 @@ class AInventoryProjectGameMode : public AGameModeBase
 
 public:
 	AInventoryProjectGameMode();
+
+	// Starts the inventory soak test when the game runs with -InventorySoak
+	virtual void StartPlay() override;
 };
 
 